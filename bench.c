@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+#define DEFAULT_DEPTH 7
+#define DEFAULT_HASH_MB 64
+#define EVAL_ITERATIONS 10000000
+
+// Quiet and tactical middlegames, plus an endgame where the table does most of the work
+static const char *positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP1B1PPP/R2QKB1R w KQ - 0 8",
+    "2rq1rk1/pp1bppbp/3p1np1/8/3NP3/1BN1BP2/PPPQ2PP/2KR3R b - - 0 12",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+};
+
+static const int thread_counts[] = {1, 2, 4, 8, 16};
+
+void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [depth] [max threads]\n", program);
+    fprintf(stderr, "       %s --eval [nnue weights | random]\n", program);
+}
+
+// What evaluating a leaf would cost if the terms were summed over the board every time
+int evaluate_from_scratch(const GameContext *ctx)
+{
+    EvalTerms eval = compute_eval(ctx);
+    int score = taper(eval.material_mg + eval.psq_mg, eval.material_eg + eval.psq_eg, eval.phase);
+    return (ctx->turn == WH) ? score : -score;
+}
+
+// Random weights of a plausible size, the speed of the network doesn't depend on what it has learnt
+void randomize_network(Network *net)
+{
+    srand(1);
+    for (size_t i = 0; i < (size_t) NNUE_INPUTS*NNUE_HIDDEN; i++) net->feature_weights[i] = rand()%65 - 32;
+    for (size_t i = 0; i < NNUE_HIDDEN; i++) net->feature_biases[i] = rand()%129 - 64;
+    for (size_t i = 0; i < NNUE_L1; i++) {
+        for (size_t j = 0; j < 2*NNUE_HIDDEN; j++) net->l1_weights[i][j] = rand()%129 - 64;
+        net->l1_biases[i] = rand()%4097 - 2048;
+        net->output_weights[i] = rand()%129 - 64;
+    }
+    net->output_bias = 0;
+}
+
+void print_rate(const char *name, size_t count, double elapsed)
+{
+    printf("%-26s %10.3f %14.0f\n", name, elapsed, elapsed > 0 ? count/elapsed : 0.0);
+}
+
+// Evaluations per second of the incremental evaluation, against recounting the terms on every call,
+// and against the network if there is one
+int bench_eval(const Network *net)
+{
+    size_t position_count = sizeof(positions)/sizeof(positions[0]);
+    static GameContext contexts[sizeof(positions)/sizeof(positions[0])];
+    static Accumulator accumulators[sizeof(positions)/sizeof(positions[0])];
+    for (size_t i = 0; i < position_count; i++) load_fen(&contexts[i], positions[i]);
+
+    int (*const evaluators[])(const GameContext *) = {evaluate, evaluate_from_scratch};
+    const char *names[] = {"incremental", "from scratch"};
+    printf("%-26s %10s %14s\n", "evaluation", "time (s)", "evals/s");
+    // Summed so that the calls can't be optimized away
+    volatile int sink = 0;
+    for (size_t e = 0; e < 2; e++) {
+        double start = clock_seconds();
+        for (size_t i = 0; i < EVAL_ITERATIONS; i++) sink += evaluators[e](&contexts[i%position_count]);
+        print_rate(names[e], EVAL_ITERATIONS, clock_seconds() - start);
+    }
+    if (net == NULL) return 0;
+
+    for (size_t i = 0; i < position_count; i++) nnue_refresh_all(net, &contexts[i], &accumulators[i]);
+    double start = clock_seconds();
+    for (size_t i = 0; i < EVAL_ITERATIONS/10; i++) {
+        sink += nnue_evaluate(net, &accumulators[i%position_count], contexts[i%position_count].turn);
+    }
+    print_rate("nnue, accumulator ready", EVAL_ITERATIONS/10, clock_seconds() - start);
+
+    start = clock_seconds();
+    for (size_t i = 0; i < EVAL_ITERATIONS/100; i++) {
+        Accumulator acc;
+        nnue_refresh_all(net, &contexts[i%position_count], &acc);
+        sink += nnue_evaluate(net, &acc, contexts[i%position_count].turn);
+    }
+    print_rate("nnue, refreshed", EVAL_ITERATIONS/100, clock_seconds() - start);
+
+    // What the search does at every node: make a move, evaluate, take it back
+    for (int use_nnue = 0; use_nnue <= 1; use_nnue++) {
+        size_t count = 0;
+        start = clock_seconds();
+        for (size_t round = 0; round < 20000; round++) {
+            GameContext *ctx = &contexts[round%position_count];
+            MoveList moves;
+            generate_legal_moves(ctx, &moves);
+            for (unsigned int i = 0; i < moves.count; i++) {
+                Undo undo;
+                if (use_nnue) {
+                    Accumulator child;
+                    DirtyPieces dirty;
+                    nnue_dirty_pieces(ctx, moves.moves[i], &dirty);
+                    make_move(ctx, moves.moves[i], &undo);
+                    nnue_update(net, ctx, &dirty, &accumulators[round%position_count], &child);
+                    sink += nnue_evaluate(net, &child, ctx->turn);
+                } else {
+                    make_move(ctx, moves.moves[i], &undo);
+                    sink += evaluate(ctx);
+                }
+                unmake_move(ctx, moves.moves[i], &undo);
+            }
+            count += moves.count;
+        }
+        print_rate(use_nnue ? "move + nnue update" : "move + incremental", count, clock_seconds() - start);
+    }
+
+    // And how that shows in the search, which is what decides between them with the strength they play at
+    printf("\n%-26s %10s %14s %12s\n", "search to depth 6", "time (s)", "nodes", "nps");
+    static TranspositionTable tt;
+    if (!tt_init(&tt, DEFAULT_HASH_MB, false)) return 1;
+    for (int use_nnue = 0; use_nnue <= 1; use_nnue++) {
+        double elapsed = 0;
+        uint64_t nodes = 0;
+        for (size_t i = 0; i < position_count; i++) {
+            SearchResult result;
+            tt_clear(&tt);
+            search(&contexts[i], (SearchLimits) {.depth = 6, .tt = &tt, .nnue = use_nnue ? net : NULL}, &result);
+            elapsed += result.elapsed;
+            nodes += result.nodes;
+        }
+        printf("%-26s %10.3f %14llu %12.0f\n", use_nnue ? "nnue" : "classical", elapsed, (unsigned long long) nodes,
+               elapsed > 0 ? nodes/elapsed : 0.0);
+    }
+    tt_free(&tt);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && strcmp(argv[1], "--eval") == 0) {
+        init_tables();
+        if (argc == 2) return bench_eval(NULL);
+        static Network net;
+        bool random = strcmp(argv[2], "random") == 0;
+        if (!(random ? nnue_alloc(&net) : nnue_load(&net, argv[2]))) {
+            fprintf(stderr, "Could not load the network %s\n", argv[2]);
+            return 1;
+        }
+        if (random) randomize_network(&net);
+        printf("NNUE accumulator and first layer built for %s\n\n", nnue_simd_name());
+        int status = bench_eval(&net);
+        nnue_free(&net);
+        return status;
+    }
+
+    int depth = (argc > 1) ? atoi(argv[1]) : DEFAULT_DEPTH;
+    int max_threads = (argc > 2) ? atoi(argv[2]) : 16;
+    if (argc > 3 || depth < 1 || depth >= MAX_PLY || max_threads < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    init_tables();
+    static TranspositionTable tt;
+    if (!tt_init(&tt, DEFAULT_HASH_MB, false)) {
+        fprintf(stderr, "Could not allocate the hash table\n");
+        return 1;
+    }
+
+    size_t position_count = sizeof(positions)/sizeof(positions[0]);
+    double base_time = 0;
+    double base_nps = 0;
+    printf("Time to depth %d on %zu positions\n\n", depth, position_count);
+    printf("%7s %10s %14s %12s %9s %9s %10s\n", "threads", "time (s)", "nodes", "nps", "speedup", "nps x", "1st cut %");
+    for (size_t i = 0; i < sizeof(thread_counts)/sizeof(thread_counts[0]) && thread_counts[i] <= max_threads; i++) {
+        int threads = thread_counts[i];
+        double elapsed = 0;
+        uint64_t nodes = 0;
+        uint64_t cutoffs = 0, first_move_cutoffs = 0;
+        for (size_t j = 0; j < position_count; j++) {
+            GameContext ctx;
+            SearchResult result;
+            load_fen(&ctx, positions[j]);
+            // Every position starts from an empty table, otherwise later runs would profit from earlier ones
+            tt_clear(&tt);
+            search(&ctx, (SearchLimits) {.depth = depth, .tt = &tt, .threads = threads}, &result);
+            elapsed += result.elapsed;
+            nodes += result.nodes;
+            cutoffs += result.cutoffs;
+            first_move_cutoffs += result.first_move_cutoffs;
+        }
+        double nps = elapsed > 0 ? nodes/elapsed : 0.0;
+        if (threads == 1) {
+            base_time = elapsed;
+            base_nps = nps;
+        }
+        printf("%7d %10.3f %14llu %12.0f %9.2f %9.2f %10.1f\n", threads, elapsed, (unsigned long long) nodes, nps,
+               elapsed > 0 ? base_time/elapsed : 0.0, base_nps > 0 ? nps/base_nps : 0.0,
+               cutoffs > 0 ? 100.0*first_move_cutoffs/cutoffs : 0.0);
+    }
+
+    tt_free(&tt);
+    return 0;
+}
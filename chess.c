@@ -5,560 +5,317 @@
 #include <math.h>
 #include <string.h>
 
+#include "rules.h"
+#include "engine.h"
+#include "history.h"
+#include "profile.h"
+#include "uci.h"
+
 #define BOARD_SIZE 800
 #define SQUARE_SIZE (BOARD_SIZE/8)
 #define SCREEN_HORIZ_PAD 400
 #define SCREEN_HEIGHT BOARD_SIZE
 #define SCREEN_WIDTH (BOARD_SIZE + SCREEN_HORIZ_PAD)
-#define MOVE_BUFFER_CAP 30
-#define MOVE_HISTORY_CAP 200
-
-typedef enum {
-    WH, BL, NONE
-} Player;
-
-typedef enum {
-    PAWN, ROOK, BISHOP, KNIGHT, QUEEN, KING, EMPTY
-} PieceType;
-
-typedef enum {
-    A = 1, B, C, D, E, F, G, H
-} Column;
-
-typedef int Row;
-
-typedef enum {
-    MOVE, CAPTURE, EN_PASSANT, CASTLES_SHORT, CASTLES_LONG
-} MoveType;
-
-typedef struct {
-    Row row;
-    Column col;
-} Square;
-
-typedef struct {
-    Square from;
-    Square to;
-    MoveType type;
-} Move;
-
+#define ENGINE_TIME_LIMIT 3.0
+#define TARGET_FPS 60
+// The search reports its progress ten times per second, more frames would mostly draw the same one.
+// Twice that still catches a quick tap on SPACE.
+#define THINKING_FPS 20
+#define DEFAULT_HASH_MB 64
+#define DEFAULT_PROFILE_CSV "profile.csv"
+
+// Legal moves of the side to move sorted by origin square. They are generated once whenever the position changes,
+// then the highlights, the drop of a piece, the notation and the end of the game all look them up.
 typedef struct {
-    PieceType type;
-    Player player;
-    Row row;
-    Column col;
-    bool selected;
-} Piece;
+    MoveList list;
+    unsigned int first[65];     // The moves from square `s` go from list.moves[first[s]] up to list.moves[first[s + 1]]
+    uint64_t key;               // Of the position the moves belong to
+    bool valid;
+} MoveTable;
 
+// The moves of one piece, inside a MoveTable
 typedef struct {
-    Piece board[8][8];
-    Player turn;
-    bool check;
-    bool mate;
-    Move last_move;
-    bool can_castle_short[2];
-    bool can_castle_long[2];
-    bool accept_move;
-    bool promotion;
-    size_t moves;
-} GameContext;
-
-typedef struct {
-    Move moves[MOVE_BUFFER_CAP];
+    const Move *moves;
     unsigned int count;
-} MoveBuffer;
+} MoveSlice;
+
+// Where the time of each frame goes, shown by F3 and written to a CSV file by F4
+static Profiler profiler;
 
-static inline void flush_move_buffer(MoveBuffer *buf)
+// Only generates the moves again if the position is not the one the table was built for
+MoveTable *current_moves(const GameContext *ctx, MoveTable *table)
 {
-    buf->count = 0;
+    if (table->valid && table->key == ctx->key) return table;
+    ProfileSection previous = profile_enter(&profiler, PROFILE_MOVEGEN);
+    MoveList legal_moves;
+    generate_legal_moves(ctx, &legal_moves);
+    unsigned int next[64] = {0};
+    for (unsigned int i = 0; i < legal_moves.count; i++) next[move_from(legal_moves.moves[i])]++;
+    table->first[0] = 0;
+    for (int square = 0; square < 64; square++) {
+        table->first[square + 1] = table->first[square] + next[square];
+        next[square] = table->first[square];
+    }
+    for (unsigned int i = 0; i < legal_moves.count; i++) table->list.moves[next[move_from(legal_moves.moves[i])]++] = legal_moves.moves[i];
+    table->list.count = legal_moves.count;
+    table->key = ctx->key;
+    table->valid = true;
+    profile_count(&profiler, PROFILE_GENERATIONS, 1);
+    profile_count(&profiler, PROFILE_MOVES_GENERATED, legal_moves.count);
+    profile_enter(&profiler, previous);
+    return table;
 }
 
-bool is_threatened(Row, Column, Player, GameContext);
+// The status of the position on the board and the notation of one of its moves, from the moves in the table
+GameStatus board_status(GameContext *ctx, MoveTable *table)
+{
+    MoveList *legal_moves = &current_moves(ctx, table)->list;
+    ProfileSection previous = profile_enter(&profiler, PROFILE_STATUS);
+    GameStatus status = game_status(ctx, legal_moves);
+    profile_enter(&profiler, previous);
+    return status;
+}
 
-#define board_at(row, col) board[row - 1][col - 1]
-#define EMPTY_PIECE(r, c) (Piece) {.type = EMPTY, .player = NONE, .row = r, .col = c}
-void initialize_board(GameContext *ctx)
+void board_notation(Move move, GameContext *ctx, MoveTable *table, char *notation)
 {
-    for (Row row = 1; row <= 8; row++) {
-        for (Column col = A; col <= H; col++) {
-            ctx->board_at(row, col) = EMPTY_PIECE(row, col);
-        }
-    }
-    for (int col = A; col <= H; col++) {
-        ctx->board_at(2, col) = (Piece) {.type = PAWN, .player = WH, .row = 2, .col = col};
-        ctx->board_at(7, col) = (Piece) {.type = PAWN, .player = BL, .row = 7, .col = col};
-    }
-    ctx->board_at(1, A) = (Piece) {.type = ROOK, .player = WH, .col = A, .row = 1};
-    ctx->board_at(1, B) = (Piece) {.type = KNIGHT, .player = WH, .col = B, .row = 1};
-    ctx->board_at(1, C) = (Piece) {.type = BISHOP, .player = WH, .col = C, .row = 1};
-    ctx->board_at(1, D) = (Piece) {.type = QUEEN, .player = WH, .col = D, .row = 1};
-    ctx->board_at(1, E) = (Piece) {.type = KING, .player = WH, .col = E, .row = 1};
-    ctx->board_at(1, F) = (Piece) {.type = BISHOP, .player = WH, .col = F, .row = 1};
-    ctx->board_at(1, G) = (Piece) {.type = KNIGHT, .player = WH, .col = G, .row = 1};
-    ctx->board_at(1, H) = (Piece) {.type = ROOK, .player = WH, .col = H, .row = 1};
-
-    ctx->board_at(8, A) = (Piece) {.type = ROOK, .player = BL, .col = A, .row = 8};
-    ctx->board_at(8, B) = (Piece) {.type = KNIGHT, .player = BL, .col = B, .row = 8};
-    ctx->board_at(8, C) = (Piece) {.type = BISHOP, .player = BL, .col = C, .row = 8};
-    ctx->board_at(8, D) = (Piece) {.type = QUEEN, .player = BL, .col = D, .row = 8};
-    ctx->board_at(8, E) = (Piece) {.type = KING, .player = BL, .col = E, .row = 8};
-    ctx->board_at(8, F) = (Piece) {.type = BISHOP, .player = BL, .col = F, .row = 8};
-    ctx->board_at(8, G) = (Piece) {.type = KNIGHT, .player = BL, .col = G, .row = 8};
-    ctx->board_at(8, H) = (Piece) {.type = ROOK, .player = BL, .col = H, .row = 8};
+    MoveList *legal_moves = &current_moves(ctx, table)->list;
+    ProfileSection previous = profile_enter(&profiler, PROFILE_NOTATION);
+    algebraic_notation(move, ctx, legal_moves, notation);
+    profile_enter(&profiler, previous);
 }
 
-void initialize_game(GameContext *ctx)
+static inline MoveSlice moves_from(const MoveTable *table, int square)
 {
-    initialize_board(ctx);
-    ctx->turn = WH;
-    ctx->check = false;
-    ctx->mate = false;
-    ctx->can_castle_short[WH] = true;
-    ctx->can_castle_short[BL] = true;
-    ctx->can_castle_long[WH] = true;
-    ctx->can_castle_long[BL] = true;
-    ctx->accept_move = true;
-    ctx->promotion = false;
-    ctx->moves = 0;
+    return (MoveSlice) {.moves = &table->list.moves[table->first[square]], .count = table->first[square + 1] - table->first[square]};
 }
 
-void DrawBackground()
+// The squares never change, so they are drawn once into a texture that each frame only copies
+RenderTexture2D LoadBoardTexture(void)
 {
-    ClearBackground(BROWN);
+    RenderTexture2D board = LoadRenderTexture(BOARD_SIZE, BOARD_SIZE);
+    BeginTextureMode(board);
     for (int i = 0; i < 8; i++) {
         for (int j = 0; j < 8; j++) {
-            float square_size = BOARD_SIZE / 8;
-            int x = i * square_size;
-            int y = j * square_size;
             Color square_color;
             if ((i + j) % 2 == 0) square_color = BLACK; else square_color = WHITE;
-            DrawRectangle(x, y, square_size, square_size, square_color);
+            DrawRectangle(i * SQUARE_SIZE, j * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE, square_color);
         }
     }
+    EndTextureMode();
+    return board;
 }
 
-void DrawPieces(GameContext ctx, Texture2D texture)
+void DrawBackground(RenderTexture2D board)
 {
-    // TODO: functions to convert between (row, col) and (screen_x, screen_y)
-    // TODO: accept `BoardRect`
-    int pad_x;
-    int pad_y;
-    Rectangle rec;
-    Vector2 pos;
-    for (Row row = 1; row <= 8; row++) {
-        for (Column col = A; col <= H; col++) {
-            Piece piece = ctx.board_at(row, col);
-            if (piece.type == EMPTY) continue;
-            if (piece.type == ROOK) {
-                rec = (Rectangle) {
-                    .x = 3,
-                    .y = 179,
-                    .width = 47,
-                    .height = 243 - 179
-                };
-                pad_x = 27;
-                pad_y = 22;
-            } else if (piece.type == BISHOP) {
-                rec = (Rectangle) {
-                    .x = 139,
-                    .y = 177,
-                    .width = 70,
-                    .height = 250 - 179
-                };
-                pad_x = 15;
-                pad_y = 18;
-            } else if (piece.type == KNIGHT) {
-                rec = (Rectangle) {
-                    .x = 364,
-                    .y = 181,
-                    .width = 65,
-                    .height = 65
-                };
-                pad_x = 15;
-                pad_y = 18;
-            } else if (piece.type == QUEEN) {
-                rec = (Rectangle) {
-                    .x = 286,
-                    .y = 180,
-                    .width = 70,
-                    .height = 65
-                };
-                pad_x = 15;
-                pad_y = 18;
-            } else if (piece.type == KING) {
-                rec = (Rectangle) {
-                    .x = 217,
-                    .y = 178,
-                    .width = 67,
-                    .height = 62
-                };
-                pad_x = 15;
-                pad_y = 18;
-            } else if (piece.type == PAWN) {
-                rec = (Rectangle) {
-                    .x = 452,
-                    .y = 180,
-                    .width = 40,
-                    .height = 70
-                };
-                pad_x = 31;
-                pad_y = 16;
-            }
-            if (piece.player == BL) rec.y += 83;
-            pad_y = -pad_y;
-            if (piece.selected) {
-                pos = GetMousePosition();
-            } else {
-                pos = (Vector2) {.x = (col - 1) * BOARD_SIZE / 8 + pad_x, .y = SCREEN_HEIGHT - (row * BOARD_SIZE / 8 + pad_y)};
-            }
-            DrawTextureRec(texture, rec, pos, WHITE);
-        }
-    }
-}
-
-void allocate_move(Square from, Square to, MoveType type, MoveBuffer *buf)
-{
-    buf->moves[buf->count].from = from;
-    buf->moves[buf->count].to = to;    
-    buf->moves[buf->count].type = type;
-    (buf->count)++;
+    ClearBackground(BROWN);
+    // Render textures are stored upside down, hence the negative height
+    DrawTextureRec(board.texture, (Rectangle) {0, 0, BOARD_SIZE, -BOARD_SIZE}, (Vector2) {0, 0}, WHITE);
 }
 
-void calculate_diagonal_moves(Piece p, MoveBuffer *possible_moves, GameContext ctx)
+// Outlines the squares of `hanging`, under the pieces standing on them
+void DrawHangingPieces(Bitboard hanging)
 {
-    Row r;
-    Column c;
-    for (int i = 1; i < 8; i++) {
-        r = p.row + i;
-        c = p.col + i;
-        if (r > 8 || c > H) break;
-        if (ctx.board_at(r, c).type != EMPTY) {
-            if (ctx.board_at(r, c).player == p.player) {break;}
-            else {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, CAPTURE, possible_moves);
-                break;
-            }
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, MOVE, possible_moves);
-    }
-    for (int i = 1; i < 8; i++) {
-        r = p.row - i;
-        c = p.col + i;
-        if (r < 1 || c > H) break;
-        if (ctx.board_at(r, c).type != EMPTY) {
-            if (ctx.board_at(r, c).player == p.player) {break;}
-            else {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, CAPTURE, possible_moves);
-                break;
-            }
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, MOVE, possible_moves);
-    }
-    for (int i = 1; i < 8; i++) {
-        r = p.row + i;
-        c = p.col - i;
-        if (r > 8 || c < A) break;
-        if (ctx.board_at(r, c).type != EMPTY) {
-            if (ctx.board_at(r, c).player == p.player) {break;}
-            else {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, CAPTURE, possible_moves);
-                break;
-            }
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, MOVE, possible_moves);
-    }
-    for (int i = 1; i < 8; i++) {
-        r = p.row - i;
-        c = p.col - i;
-        if (r < 1 || c < A) break;
-        if (ctx.board_at(r, c).type != EMPTY) {
-            if (ctx.board_at(r, c).player == p.player) {break;}
-            else {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, CAPTURE, possible_moves);
-                break;
-            }
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, MOVE, possible_moves);
+    while (hanging) {
+        Square sq = square_of(pop_lsb(&hanging));
+        Rectangle rec = {(sq.col - 1) * SQUARE_SIZE, BOARD_SIZE - sq.row * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE};
+        DrawRectangleLinesEx(rec, 6, ORANGE);
     }
 }
 
-void calculate_orthogonal_moves(Piece p, MoveBuffer *possible_moves, GameContext ctx)
+// Where each piece is in assets/pieces.png, white on top and black PIECE_SPRITE_BLACK_Y lower, and
+// where it goes from the top left corner of its square
+typedef struct {
+    Rectangle source;
+    Vector2 offset;
+} PieceSprite;
+
+#define PIECE_SPRITE_BLACK_Y 83
+
+static const PieceSprite piece_sprites[EMPTY] = {
+    [PAWN]   = {.source = {452, 180, 40, 70}, .offset = {31, 16}},
+    [ROOK]   = {.source = {3, 179, 47, 64},   .offset = {27, 22}},
+    [BISHOP] = {.source = {139, 177, 70, 71}, .offset = {15, 18}},
+    [KNIGHT] = {.source = {364, 181, 65, 65}, .offset = {15, 18}},
+    [QUEEN]  = {.source = {286, 180, 70, 65}, .offset = {15, 18}},
+    [KING]   = {.source = {217, 178, 67, 62}, .offset = {15, 18}},
+};
+
+static inline Rectangle piece_source(PieceType type, Player player)
 {
-    Row r;
-    Column c;
-    for (int i = 1; i < 8; i++) {
-        r = p.row + i;
-        if (r > 8) break;
-        if (ctx.board_at(r, p.col).type != EMPTY) {
-            if (ctx.board_at(r, p.col).player == 1 - p.player) {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = p.col}, CAPTURE, possible_moves);
-            } 
-            break;
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = p.col}, MOVE, possible_moves);
-    }
-    for (int i = 1; i < 8; i++) {
-        r = p.row - i;
-        if (r < 1) break;
-        if (ctx.board_at(r, p.col).type != EMPTY) {
-            if (ctx.board_at(r, p.col).player == 1 - p.player) {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = p.col}, CAPTURE, possible_moves);
-            } 
-            break;
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = p.col}, MOVE, possible_moves);
-    }
-    for (int i = 1; i < 8; i++) {
-        c = p.col + i;
-        if (c > H) break;
-        if (ctx.board_at(p.row, c).type != EMPTY) {
-            if (ctx.board_at(p.row, c).player == 1 - p.player) {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row, .col = c}, CAPTURE, possible_moves);
-            } 
-            break;
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row, .col = c}, MOVE, possible_moves);
-    }
-    for (int i = 1; i < 8; i++) {
-        c = p.col - i;
-        if (c < A) break;
-        if (ctx.board_at(p.row, c).type != EMPTY) {
-            if (ctx.board_at(p.row, c).player == 1 - p.player) {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row, .col = c}, CAPTURE, possible_moves);
-            } 
-            break;
-        }
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row, .col = c}, MOVE, possible_moves);
-    }
+    Rectangle source = piece_sprites[type].source;
+    if (player == BL) source.y += PIECE_SPRITE_BLACK_Y;
+    return source;
 }
 
-void calculate_possible_moves(Piece p, MoveBuffer *possible_moves, GameContext ctx)
+void DrawPieces(const GameContext *ctx, Texture2D texture, const Square *dragged)
 {
-    Row r;
-    Column c;
-    if (p.type == PAWN) {
-        int direction = (p.player == WH) ? 1 : -1;
-        Row starting_row = (p.player == WH) ? 2 : 7;
-        if (p.col + 1 <= H && ctx.board_at(p.row + direction, p.col + 1).player == 1 - p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + direction, .col = p.col + 1}, CAPTURE, possible_moves);
-        }
-        if (p.col - 1 >= A && ctx.board_at(p.row + direction, p.col - 1).player == 1 - p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + direction, .col = p.col - 1}, CAPTURE, possible_moves);
-        }
-        if (p.col + 1 <= H && ctx.board_at(p.row, p.col + 1).type == PAWN && ctx.board_at(p.row, p.col + 1).player == 1 - p.player && ctx.board_at(ctx.last_move.to.row, ctx.last_move.to.col).type == PAWN && abs(ctx.last_move.from.row - ctx.last_move.to.row) == 2 && ctx.last_move.to.row == p.row && ctx.last_move.to.col == p.col + 1) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + direction, .col = p.col + 1}, EN_PASSANT, possible_moves);
-        }
-        if (p.col - 1 >= A && ctx.board_at(p.row, p.col - 1).type == PAWN && ctx.board_at(p.row, p.col - 1).player == 1 - p.player && ctx.board_at(ctx.last_move.to.row, ctx.last_move.to.col).type == PAWN && abs(ctx.last_move.from.row - ctx.last_move.to.row) == 2 && ctx.last_move.to.row == p.row && ctx.last_move.to.col == p.col - 1) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + direction, .col = p.col - 1}, EN_PASSANT, possible_moves);
-        }
-        if (p.row == 1 || p.row == 8) return;
-        if (ctx.board_at(p.row + direction, p.col).type != EMPTY) return;
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + direction, .col = p.col}, MOVE, possible_moves);
-        
-        if (ctx.board_at(p.row + 2*direction, p.col).type != EMPTY || p.row != starting_row) return;
-        allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + 2*direction, .col = p.col}, MOVE, possible_moves);        
-    } else if (p.type == KNIGHT) {
-        // NOTE: the enum literals are of type unsigned int. If you have `Column c = 0;` and you decrement its value `c--;`, it goes to the maximum value of unsigned int
-        // Therefore, before comparing them to the minimum values, if they might be negative (which is the case for col - 2), you must cast to int before the comparison
-        if (p.row + 2 <= 8 && p.col + 1 <= H && ctx.board_at(p.row + 2, p.col + 1).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + 2, .col = p.col + 1}, (ctx.board_at(p.row + 2, p.col + 1).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if (p.row + 2 <= 8 && (int) p.col - 1 >= A && ctx.board_at(p.row + 2, p.col - 1).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + 2, .col = p.col - 1}, (ctx.board_at(p.row + 2, p.col - 1).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if ((int) p.row - 2 >= 1 && p.col + 1 <= H && ctx.board_at(p.row - 2, p.col + 1).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row - 2, .col = p.col + 1}, (ctx.board_at(p.row - 2, p.col + 1).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if ((int) p.row - 2 >= 1 && (int) p.col - 1 >= A && ctx.board_at(p.row - 2, p.col - 1).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row - 2, .col = p.col - 1}, (ctx.board_at(p.row - 2, p.col - 1).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if (p.row + 1 <= 8 && p.col + 2 <= H && ctx.board_at(p.row + 1, p.col + 2).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + 1, .col = p.col + 2}, (ctx.board_at(p.row + 1, p.col + 2).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if (p.row + 1 <= 8 && (int) p.col - 2 >= A && ctx.board_at(p.row + 1, p.col - 2).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row + 1, .col = p.col - 2}, (ctx.board_at(p.row + 1, p.col - 2).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if ((int) p.row - 1 >= 1 && p.col + 2 <= H && ctx.board_at(p.row - 1, p.col + 2).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row - 1, .col = p.col + 2}, (ctx.board_at(p.row - 1, p.col + 2).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-        if ((int) p.row - 1 >= 1 && (int) p.col - 2 >= A && ctx.board_at(p.row - 1, p.col - 2).player != p.player) {
-            allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row - 1, .col = p.col - 2}, (ctx.board_at(p.row - 1, p.col - 2).player == NONE) ? MOVE : CAPTURE, possible_moves);
-        }
-    } else if (p.type == BISHOP) {
-        calculate_diagonal_moves(p, possible_moves, ctx);
-    } else if (p.type == ROOK) {
-        calculate_orthogonal_moves(p, possible_moves, ctx);
-    } else if (p.type == QUEEN) {
-        calculate_diagonal_moves(p, possible_moves, ctx);
-        calculate_orthogonal_moves(p, possible_moves, ctx);
-    } else if (p.type == KING) {
-        if (ctx.can_castle_short[p.player]) {
-            // TODO: we might wanna make an assertion that the king and the rook are on their initial squares
-            if (ctx.board_at(p.row, p.col + 1).type == EMPTY && ctx.board_at(p.row, p.col + 2).type == EMPTY && !is_threatened(p.row, p.col + 1, 1 - p.player, ctx) && !is_threatened(p.row, p.col + 2, 1 - p.player, ctx)) {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row, .col = p.col + 2}, CASTLES_SHORT, possible_moves);
-            }
-        }
-        if (ctx.can_castle_long[p.player]) {
-            // TODO: we might wanna make an assertion that the king and the rook are on their initial squares
-            if (ctx.board_at(p.row, p.col - 1).type == EMPTY && ctx.board_at(p.row, p.col - 2).type == EMPTY && ctx.board_at(p.row, p.col - 3).type == EMPTY && !is_threatened(p.row, p.col - 1, 1 - p.player, ctx) && !is_threatened(p.row, p.col - 2, 1 - p.player, ctx) && !is_threatened(p.row, p.col - 3, 1 - p.player, ctx)) {
-                allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = p.row, .col = p.col - 2}, CASTLES_LONG, possible_moves);
+    // TODO: functions to convert between (row, col) and (screen_x, screen_y)
+    // TODO: accept `BoardRect`
+    Bitboard skipped = (dragged != NULL) ? SQUARE_BB(dragged->row, dragged->col) : 0;
+    for (Player player = WH; player <= BL; player++) {
+        for (PieceType type = PAWN; type < EMPTY; type++) {
+            Rectangle source = piece_source(type, player);
+            Bitboard pieces = ctx->pieces[type] & ctx->players[player] & ~skipped;
+            while (pieces) {
+                Square sq = square_of(pop_lsb(&pieces));
+                Vector2 pos = {
+                    .x = (sq.col - 1) * SQUARE_SIZE + piece_sprites[type].offset.x,
+                    .y = BOARD_SIZE - sq.row * SQUARE_SIZE + piece_sprites[type].offset.y
+                };
+                DrawTextureRec(texture, source, pos, WHITE);
             }
         }
-        for (int drow = -1; drow <= 1; drow++) {
-            for (int dcol = -1; dcol <= 1; dcol++) {
-                if (drow == 0 && dcol == 0) continue;
-                r = p.row + drow;
-                c = p.col + dcol;
-                if (r >= 1 && r <= 8 && c >= A && c <= H && ctx.board_at(r, c).player != p.player) {
-                    allocate_move((Square) { .row = p.row, .col = p.col}, (Square) {.row = r, .col = c}, (ctx.board_at(r, c).player == NONE) ? MOVE : CAPTURE, possible_moves);
-                }
-            }
-        }        
-    } else {
-        printf("Unknown piece type");
+    }
+    // Drawn last, so that the piece being dragged passes over the others
+    if (dragged != NULL) {
+        Piece piece = piece_at(ctx, dragged->row, dragged->col);
+        if (piece.type != EMPTY) DrawTextureRec(texture, piece_source(piece.type, piece.player), GetMousePosition(), WHITE);
     }
 }
 
-void DrawPossibleMoves(MoveBuffer possible_moves)
+void DrawPossibleMoves(MoveSlice possible_moves)
 {
     const float r = 10.0f;
     for (unsigned int i = 0; i < possible_moves.count; i++) {
-        int x = (possible_moves.moves[i].to.col - 1) * SQUARE_SIZE + SQUARE_SIZE/2;
-        int y = BOARD_SIZE - (possible_moves.moves[i].to.row - 1) * SQUARE_SIZE - SQUARE_SIZE/2;
-        if (possible_moves.moves[i].type == MOVE || possible_moves.moves[i].type == CASTLES_SHORT || possible_moves.moves[i].type == CASTLES_LONG) DrawCircle(x, y, r, GRAY);
-        else if (possible_moves.moves[i].type == CAPTURE || possible_moves.moves[i].type == EN_PASSANT) DrawCircle(x, y, r, RED);
+        Square to = square_of(move_to(possible_moves.moves[i]));
+        MoveType type = move_type(possible_moves.moves[i]);
+        int x = (to.col - 1) * SQUARE_SIZE + SQUARE_SIZE/2;
+        int y = BOARD_SIZE - (to.row - 1) * SQUARE_SIZE - SQUARE_SIZE/2;
+        if (type == MOVE || type == CASTLES_SHORT || type == CASTLES_LONG) DrawCircle(x, y, r, GRAY);
+        else if (type == CAPTURE || type == EN_PASSANT) DrawCircle(x, y, r, RED);
     }
 }
 
-bool is_possible(Row r, Column c, MoveBuffer possible_moves, unsigned int *index)
+bool is_possible(Row r, Column c, MoveSlice possible_moves, unsigned int *index)
 {
+    ProfileSection previous = profile_enter(&profiler, PROFILE_MOVEGEN);
+    bool found = false;
     for (unsigned int i = 0; i < possible_moves.count; i++) {
-        if (possible_moves.moves[i].to.row == r && possible_moves.moves[i].to.col == c) {
+        if (move_to(possible_moves.moves[i]) == SQUARE_INDEX(r, c)) {
             *index = i;
-            return true;   
-        }
-    }
-    return false;
-}
-
-void find_king(GameContext ctx, Player p, Square *king_square)
-{
-    for (int row = 1; row <= 8; row++) {
-        for (int col = A; col <= H; col++) {
-            if (ctx.board_at(row, col).player == p && ctx.board_at(row, col).type == KING) {
-                *king_square = (Square) {.row = row, .col = col};
-                return;
-            } 
+            found = true;
+            break;
         }
     }
+    profile_enter(&profiler, previous);
+    return found;
 }
 
-bool is_check(GameContext ctx)
-{
-    MoveBuffer possible_moves = {0};
-    Square king_square;
-    unsigned int move_index;
-    
-    find_king(ctx, ctx.turn, &king_square);
-    for (int row = 1; row <= 8; row++) {
-        for (int col = A; col <= H; col++) {
-            if (ctx.board_at(row, col).player != 1 - ctx.turn) continue;
-            if (ctx.board_at(row, col).type == KING) continue;
-            calculate_possible_moves(ctx.board_at(row, col), &possible_moves, ctx);
-            if (is_possible(king_square.row, king_square.col, possible_moves, &move_index)) return true;
-            flush_move_buffer(&possible_moves);
-        }
-    }
-    return false;
-}
+// Text wrapped to a width, with where each line goes. Measuring the words is what makes laying a text out slow,
+// and most texts on screen stay the same for many frames, so the layouts are kept until the text changes.
+#define TEXT_CAP 512
+#define TEXT_MAX_LINES 16
+#define TEXT_CACHE_SIZE 32
 
-void apply_move(Move move, GameContext *ctx)
+typedef struct {
+    // What the layout depends on
+    char text[TEXT_CAP];
+    unsigned int font_id;
+    int font_size;
+    float spacing;
+    float width;                // Lines wrap to it, none if 0
+    uint64_t hash;              // Of all the above, to skip most string comparisons
+    // The lines one after the other, each ending with '\0'
+    char lines[TEXT_CAP];
+    unsigned int line_starts[TEXT_MAX_LINES];
+    float line_ys[TEXT_MAX_LINES];
+    unsigned int line_count;
+    Vector2 size;
+    unsigned long last_used;
+} TextLayout;
+
+static TextLayout text_cache[TEXT_CACHE_SIZE];
+static unsigned long text_cache_clock;
+
+static uint64_t text_hash(const char *text, unsigned int font_id, int font_size, float spacing, float width)
 {
-    ctx->board_at(move.to.row, move.to.col) = ctx->board_at(move.from.row, move.from.col);
-    ctx->board_at(move.to.row, move.to.col).row = move.to.row;
-    ctx->board_at(move.to.row, move.to.col).col = move.to.col;
-    ctx->board_at(move.to.row, move.to.col).selected = false;
-    ctx->board_at(move.from.row, move.from.col) = EMPTY_PIECE(move.from.row, move.from.col);
-    if (move.type == EN_PASSANT) {
-        ctx->board_at(move.from.row, move.to.col) = EMPTY_PIECE(move.from.row, move.to.col);
-    } else if (move.type == CASTLES_SHORT) {
-        ctx->board_at(move.to.row, move.to.col - 1) = ctx->board_at(move.to.row, move.to.col + 1);
-        ctx->board_at(move.to.row, move.to.col - 1).col = move.to.col - 1;
-        ctx->board_at(move.to.row, move.to.col + 1) =  EMPTY_PIECE(move.to.row, move.to.col + 1);
-    } else if (move.type == CASTLES_LONG) {
-        ctx->board_at(move.to.row, move.to.col + 1) = ctx->board_at(move.to.row, A);
-        ctx->board_at(move.to.row, move.to.col + 1).col = move.to.col + 1;
-        ctx->board_at(move.to.row, A) =  EMPTY_PIECE(move.to.row, A);;
-    }
+    // FNV-1a
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const char *c = text; *c != '\0'; c++) hash = (hash ^ (unsigned char) *c) * 0x100000001B3ull;
+    hash = (hash ^ font_id) * 0x100000001B3ull;
+    hash = (hash ^ (unsigned int) font_size) * 0x100000001B3ull;
+    hash = (hash ^ (uint64_t) (spacing*64)) * 0x100000001B3ull;
+    return (hash ^ (uint64_t) (width*64)) * 0x100000001B3ull;
 }
 
-void validate_possible_moves(Piece p, MoveBuffer *possible_moves, GameContext ctx)
+// Words go on the current line while it fits in `width`, a word wider than a whole line getting one of its own
+static void wrap_text(TextLayout *layout, Font font)
 {
-    int new_count = 0;
-    GameContext next_ctx = ctx;
-    Piece piece_at_target;
-    Move move;
-    bool check;
-
-    if (possible_moves->count == 0) return;
-
-    for (unsigned int i = 0; i < possible_moves->count; i++) {
-        // Perform the move in the next_board
-        move = possible_moves->moves[i];
-        piece_at_target = next_ctx.board_at(move.to.row, move.to.col);
-        apply_move(move, &next_ctx);
-        check = is_check(next_ctx);
-        if (!check) {
-            possible_moves->moves[new_count] = move;
-            new_count++;
-        }
-        // TODO: this might not be enough to deapply the move
-        next_ctx.board_at(p.row, p.col) = p;
-        next_ctx.board_at(move.to.row, move.to.col) = piece_at_target;
+    size_t length = 0;
+    layout->line_count = 0;
+    layout->size = (Vector2) {0, 0};
+    const char *begin = layout->text;
+    while (*begin == ' ') begin++;
+    while (*begin != '\0' && layout->line_count < TEXT_MAX_LINES) {
+        size_t line_start = length;
+        const char *end = begin;
+        Vector2 line_size = {0, (float) layout->font_size};
+        while (*begin != '\0') {
+            end = begin;
+            while (*end != ' ' && *end != '\0') end++;
+            // Try the line with the next word
+            size_t tried = length;
+            if (length > line_start) layout->lines[tried++] = ' ';
+            memcpy(&layout->lines[tried], begin, end - begin);
+            tried += end - begin;
+            layout->lines[tried] = '\0';
+            Vector2 measures = MeasureTextEx(font, &layout->lines[line_start], layout->font_size, layout->spacing);
+            if (layout->width > 0 && measures.x >= layout->width && length > line_start) break;
+            length = tried;
+            line_size = measures;
+            begin = end;
+            while (*begin == ' ') begin++;
+        }
+        layout->lines[length++] = '\0';
+        layout->line_starts[layout->line_count] = line_start;
+        layout->line_ys[layout->line_count] = layout->size.y;
+        layout->line_count++;
+        if (line_size.x > layout->size.x) layout->size.x = line_size.x;
+        layout->size.y += line_size.y;
     }
-    possible_moves->count = new_count;
 }
 
-bool is_threatened(Row row, Column col, Player p, GameContext ctx)
+// The layout of `text`, from the cache unless it was never laid out like that or was evicted since
+const TextLayout *layout_text(Font font, const char *text, int font_size, float spacing, float width)
 {
-    MoveBuffer possible_moves = {0};
-    unsigned int move_index;
-    for (Row r = 1; r <= 8; r++) {
-        for (Column c = A; c <= H; c++) {
-            if (ctx.board_at(r, c).player != p) continue;
-            if (ctx.board_at(r, c).type == KING) continue;
-            calculate_possible_moves(ctx.board_at(r, c), &possible_moves, ctx);
-            validate_possible_moves(ctx.board_at(r, c), &possible_moves, ctx);
-            if (is_possible(row, col, possible_moves, &move_index)) return true;
-            flush_move_buffer(&possible_moves);
-        }
+    uint64_t hash = text_hash(text, font.texture.id, font_size, spacing, width);
+    TextLayout *oldest = &text_cache[0];
+    text_cache_clock++;
+    for (size_t i = 0; i < TEXT_CACHE_SIZE; i++) {
+        TextLayout *layout = &text_cache[i];
+        if (layout->last_used > 0 && layout->hash == hash && layout->font_id == font.texture.id && layout->font_size == font_size
+            && layout->spacing == spacing && layout->width == width && strcmp(layout->text, text) == 0) {
+            layout->last_used = text_cache_clock;
+            return layout;
+        }
+        if (layout->last_used < oldest->last_used) oldest = layout;
     }
-    return false;
+    profile_count(&profiler, PROFILE_TEXT_LAYOUTS, 1);
+    snprintf(oldest->text, TEXT_CAP, "%s", text);
+    oldest->font_id = font.texture.id;
+    oldest->font_size = font_size;
+    oldest->spacing = spacing;
+    oldest->width = width;
+    oldest->hash = hash;
+    oldest->last_used = text_cache_clock;
+    wrap_text(oldest, font);
+    return oldest;
 }
 
-bool is_mate(GameContext ctx)
+void DrawTextLayout(const TextLayout *layout, Font font, Vector2 pos, Color color)
 {
-    MoveBuffer possible_moves = {0};
-    for (Row r = 1; r <= 8; r++) {
-        for (Column c = A; c <= H; c++) {
-            if (ctx.board_at(r, c).player != ctx.turn) continue;
-            calculate_possible_moves(ctx.board_at(r, c), &possible_moves, ctx);
-            validate_possible_moves(ctx.board_at(r, c), &possible_moves, ctx);
-            if (possible_moves.count > 0) {
-                return false;
-            }
-            flush_move_buffer(&possible_moves);
-        }
+    for (unsigned int i = 0; i < layout->line_count; i++) {
+        Vector2 line_pos = {pos.x, pos.y + layout->line_ys[i]};
+        DrawTextEx(font, &layout->lines[layout->line_starts[i]], line_pos, layout->font_size, layout->spacing, color);
     }
-    return true;
 }
 
 // Render Functions
 void DrawTextCentered_(const char* text, float x, float y, int font_size, Font font)
 {
-    Vector2 title_render_sizes = MeasureTextEx(font, text, font_size, 0);
-    Vector2 title_pos = { .x = x - title_render_sizes.x/2, .y = y - title_render_sizes.y/2};
-    DrawTextEx(font, text, title_pos, font_size, 0, WHITE);
+    const TextLayout *layout = layout_text(font, text, font_size, 0, 0);
+    Vector2 title_pos = { .x = x - layout->size.x/2, .y = y - layout->size.y/2};
+    DrawTextLayout(layout, font, title_pos, WHITE);
 }
 #define DrawTextCentered(text, x, y, font_size) DrawTextCentered_(text, x, y, font_size, papyrus)
 
@@ -571,143 +328,161 @@ void DrawButtonWithText_(Rectangle button, const char* text, int font_size, Colo
 
 void DrawTextInRect(Rectangle r, const char* text, int font_size, Font font)
 {
-    const char* begin = text;
-    const char* end = text;
-    char word[256];
-    char line[1024];
-    size_t line_len = 0;
-    line[line_len] = '\0';
-    size_t lines = 0;
-    do {
-        // Trim left
-        while (*begin == ' ') begin++;
-        if (*begin == '\0') return;
-        end = begin;
-
-        // Find next space
-        while (*end != ' ' && *end != '\0') end++;
-
-        // Build string
-        for (const char* c = begin; c < end; c++) {
-            word[c - begin] = *c;
-        }
-        word[end - begin] = '\0';
-
-        // Measure current line and word separately
-        Vector2 measures_line = MeasureTextEx(font, line, font_size, 0);
-        Vector2 measures_word = MeasureTextEx(font, word, font_size, 0);
-
-        if (measures_line.x + measures_word.x < r.width || *end == '\0') {
-            // Append word to line
-            for (size_t i = 0; i < (size_t) (end - begin); i++) {
-                line[line_len + i] = word[i];
-            }
-            line[line_len + (end - begin)] = ' ';
-            line_len += (end - begin + 1);
-            line[line_len] = '\0';
-            // Go to next word
-            begin = end;
-        }
-        if (measures_line.x + measures_word.x > r.width || *end == '\0') {
-            // Draw line
-            DrawTextEx(font, line, (Vector2) { r.x, r.y + lines*measures_line.y }, font_size, 0, WHITE);
-            lines += 1;
-
-            // Flush word
-            line_len = 0;
-            line[line_len] = '\0';
-        }
-    } while (*end != '\0');
+    DrawTextLayout(layout_text(font, text, font_size, 0, r.width), font, (Vector2) {r.x, r.y}, WHITE);
 }
 
-bool is_move_ambiguous(Move move, GameContext ctx, Square* other_piece_square)
+// Rolling graph of the time each frame spent in each section, waiting aside, with the averages over the graph
+// and the counters. It uses the default font, and draws its numbers without the layout cache since they change.
+void DrawProfiler(const Profiler *profiler)
 {
-    // Find out if the move is ambiguous
-    Piece piece = ctx.board_at(move.from.row, move.from.col);
-    MoveBuffer buf = {0};
-    unsigned int index;
-    if (piece.type != PAWN && piece.type != KING) {
-        for (size_t row = 1; row <= 8; row++) {
-            for (size_t col = A; col <= H; col++) {
-                if (row == (size_t) piece.row && col == (size_t) piece.col) continue;
-                Piece other_piece = ctx.board_at(row, col);
-                if (other_piece.player != piece.player || other_piece.type != piece.type) continue;
-                calculate_possible_moves(other_piece, &buf, ctx);
-                if (is_possible(move.to.row, move.to.col, buf, &index)) {
-                    *other_piece_square = (Square) { .row = row, .col = col };
-                    return true;
-                }
-                flush_move_buffer(&buf);
-            }
+    static const Color colors[PROFILE_SECTIONS] = {
+        [PROFILE_INPUT] = SKYBLUE,
+        [PROFILE_MOVEGEN] = ORANGE,
+        [PROFILE_STATUS] = PURPLE,
+        [PROFILE_NOTATION] = YELLOW,
+        [PROFILE_RENDER] = LIME,
+        [PROFILE_WAIT] = GRAY,
+    };
+    const int bar_width = 2;
+    const int graph_height = 120;
+    const Rectangle box = {10, 10, PROFILE_HISTORY*bar_width + 20, graph_height + 40 + 20*(PROFILE_SECTIONS + PROFILE_COUNTERS)};
+    DrawRectangleRec(box, (Color) {0, 0, 0, 200});
+
+    // The graph is scaled to the slowest frame it shows, at least a millisecond
+    unsigned int count = profile_frame_count(profiler);
+    double average[PROFILE_SECTIONS] = {0};
+    double counters[PROFILE_COUNTERS] = {0};
+    double scale = 0.001;
+    for (unsigned int age = 0; age < count; age++) {
+        const ProfileFrame *frame = profile_frame(profiler, age);
+        double busy = profile_frame_seconds(frame) - frame->seconds[PROFILE_WAIT];
+        if (busy > scale) scale = busy;
+        for (int i = 0; i < PROFILE_SECTIONS; i++) average[i] += frame->seconds[i]/count;
+        for (int i = 0; i < PROFILE_COUNTERS; i++) counters[i] += (double) frame->counters[i]/count;
+    }
+    int bottom = box.y + 10 + graph_height;
+    for (unsigned int age = 0; age < count; age++) {
+        const ProfileFrame *frame = profile_frame(profiler, age);
+        int x = box.x + 10 + (PROFILE_HISTORY - 1 - age)*bar_width;
+        int y = bottom;
+        for (int i = 0; i < PROFILE_WAIT; i++) {
+            int height = frame->seconds[i]/scale*graph_height;
+            if (height <= 0) continue;
+            y -= height;
+            DrawRectangle(x, y, bar_width, height, colors[i]);
         }
     }
-    return false;
+    DrawLine(box.x + 10, bottom, box.x + box.width - 10, bottom, WHITE);
+
+    int y = bottom + 10;
+    DrawText(TextFormat("%u frames, top of the graph %.2f ms%s", count, scale*1000, profiler->csv != NULL ? ", recording (F4 stops)" : ""),
+             box.x + 10, y, 20, WHITE);
+    for (int i = 0; i < PROFILE_SECTIONS; i++) {
+        y += 20;
+        DrawRectangle(box.x + 10, y + 4, 12, 12, colors[i]);
+        DrawText(TextFormat("%-9s %8.3f ms", profile_section_names[i], average[i]*1000), box.x + 30, y, 20, WHITE);
+    }
+    for (int i = 0; i < PROFILE_COUNTERS; i++) {
+        y += 20;
+        DrawText(TextFormat("%-16s %10.1f per frame", profile_counter_names[i], counters[i]), box.x + 30, y, 20, WHITE);
+    }
 }
 
-void algebraic_notation(Move move, GameContext ctx, char* notation)
+// Writes the last move of the history into `notation`, which needs the position before it
+void last_move_notation(GameHistory *history, GameContext *ctx, char *notation)
 {
-    if (move.type == CASTLES_SHORT) {
-        notation = "o-o";
-        return;
-    } else if (move.type == CASTLES_LONG) {
-        notation = "o-o-o";
-        return;
-    }
-    
-    size_t index = 0;
-    Piece piece = ctx.board_at(move.from.row, move.from.col);
-    if (piece.type == PAWN && move.type == CAPTURE) {
-        notation[index++] = 'a' + move.from.col - 1;
-    } else if (piece.type == KNIGHT) {
-        notation[index++] = 'N';
-    } else if (piece.type == BISHOP) {
-        notation[index++] = 'B';
-    } else if (piece.type == ROOK) {
-        notation[index++] = 'R';
-    } else if (piece.type == KING) {
-        notation[index++] = 'K';
-    } else if (piece.type == QUEEN) {
-        notation[index++] = 'Q';
-    }
+    ProfileSection previous = profile_enter(&profiler, PROFILE_NOTATION);
+    bool check = ctx->check, mate = ctx->mate;
+    Move last = history_pop(history, ctx);
+    algebraic_notation(last, ctx, NULL, notation);
+    history_jump(history, ctx, history->ply + 1);
+    ctx->check = check;
+    ctx->mate = mate;
+    profile_enter(&profiler, previous);
+}
 
-    Square other_piece_square;
-    bool ambiguous = is_move_ambiguous(move, ctx, &other_piece_square);
+void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--uci] [--fen <fen>] [--hash <MB>] [--huge-pages] [--threads <count>] [--nnue <weights>] [--profile <csv>]\n", program);
+}
 
-    if (ambiguous) {
-        if (piece.col == other_piece_square.col) {
-            notation[index++] = '1' + piece.row - 1;
+int main(int argc, char **argv)
+{
+    size_t hash_mb = DEFAULT_HASH_MB;
+    bool huge_pages = false;
+    int threads = 1;
+    bool uci = false;
+    const char *start_fen = START_FEN;
+    const char *nnue_path = NULL;
+    const char *profile_path = DEFAULT_PROFILE_CSV;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--uci") == 0) {
+            uci = true;
+        } else if (strcmp(argv[i], "--fen") == 0 && i + 1 < argc) {
+            start_fen = argv[++i];
+        } else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc) {
+            hash_mb = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--huge-pages") == 0) {
+            huge_pages = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) threads = 1;
+            if (threads > MAX_THREADS) threads = MAX_THREADS;
+        } else if (strcmp(argv[i], "--nnue") == 0 && i + 1 < argc) {
+            nnue_path = argv[++i];
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
         } else {
-            notation[index++] = 'a' + piece.col - 1;
+            usage(argv[0]);
+            return 1;
         }
     }
 
-    if (move.type == CAPTURE) notation[index++] = 'x';
-
-    notation[index++] = 'a' + move.to.col - 1;
-    notation[index++] = '1' + move.to.row - 1;  
-
-    // TODO: make sure this is a good idea
-    // TODO: check notation is not working
-    apply_move(move, &ctx);
-    ctx.turn = 1 - ctx.turn;
-    if (is_check(ctx)) {
-        notation[index++] = '+';
+    init_tables();
+    GameContext ctx;
+    if (!load_fen(&ctx, start_fen)) {
+        fprintf(stderr, "Invalid FEN: %s\n", start_fen);
+        return 1;
+    }
+    static TranspositionTable tt;
+    if (!tt_init(&tt, hash_mb, huge_pages)) {
+        fprintf(stderr, "Could not allocate a %zu MB hash table\n", hash_mb);
+        return 1;
+    }
+    static Network nnue;
+    if (nnue_path != NULL && !nnue_load(&nnue, nnue_path)) {
+        fprintf(stderr, "Could not load the network %s\n", nnue_path);
+        return 1;
+    }
+    // Headless: no window and no audio device, so it runs on servers and as fast as the CPU allows
+    if (uci) {
+        int status = uci_loop(&tt, threads, &nnue);
+        nnue_free(&nnue);
+        tt_free(&tt);
+        return status;
     }
 
-    notation[index] = '\0';
-}
+    GameHistory history;
+    if (!history_init(&history, &ctx)) {
+        fprintf(stderr, "Could not allocate the game history\n");
+        nnue_free(&nnue);
+        tt_free(&tt);
+        return 1;
+    }
+    EngineJob engine;
+    SearchResult engine_progress = {0};
+    if (!engine_init(&engine)) fprintf(stderr, "Could not start the engine thread, the bot will think on the main thread\n");
 
-int main(void)
-{
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Chess");
     InitAudioDevice();
     // TODO: figure out icon format for SetWindowIcon(Image image)
-    SetTargetFPS(60);
+    SetTargetFPS(TARGET_FPS);
 
     // TODO: Maybe create a struct `GameAssets` to capsule all of this and 
     // a function `RenderGameState(GameContext ctx, GameAssets assets)`
     // and maybe even `GameAssets LoadGameAssets(void)`
     Texture2D piece_texture = LoadTexture("assets/pieces.png");
+    RenderTexture2D board_texture = LoadBoardTexture();
     Font papyrus = LoadFont("assets/papyrus.ttf");
     SetTextureFilter(papyrus.texture, TEXTURE_FILTER_BILINEAR);
     Sound move_sound = LoadSound("assets/move.mp3");
@@ -717,33 +492,50 @@ int main(void)
     // Program metadata to know what is the program state
     bool playing = false;
     bool tutorial = false;
-    char notation[7];
+    bool vs_engine = false;
+    // The bot evaluates with the network when one was given, E switches back and forth with the classical evaluation
+    bool use_nnue = nnue_loaded(&nnue);
+    // H outlines the pieces of the side to move that the other side wins material by taking
+    bool show_hanging = false;
+    GameStatus status = GAME_ONGOING;
+    const Player engine_player = BL;
+    char notation[16];
 
     // Variables related to chess game
     Row target_row, selected_row;
     Column target_col, selected_col;
     bool selected_piece = false;
-    bool calculated_moves = false;
-    MoveBuffer possible_moves = {0};
+    MoveTable legal_moves = {0};
+    MoveSlice possible_moves = {0};
     unsigned int move_index;
-    const Row back_row[2] = {1, 8};
     Move move;
-
-    // TODO: implement move history
-    // TODO: function to revert move, this needs a move history
-    GameContext ctx;
-    #define MOVE_HISTORY_CAP 200
-    #define CTX_HISTORY_CAP 201
-    GameContext ctx_history[CTX_HISTORY_CAP];
-    unsigned int current_move = 0;
-    
-    while (!WindowShouldClose()) {
+    // Most of the time the screen only changes when the user does something, and then the loop sleeps
+    // in EndDrawing until the next input event instead of drawing the same frame over and over
+    bool event_waiting = false;
+    int target_fps = TARGET_FPS;
+    bool show_profiler = false;
+    uint64_t counted_nodes = 0;
+    profile_init(&profiler);
+
+    bool out_of_memory = false;
+    while (!out_of_memory && !WindowShouldClose()) {
+        profile_next_frame(&profiler);
+        if (IsKeyPressed(KEY_F3)) show_profiler = !show_profiler;
+        if (IsKeyPressed(KEY_F4)) {
+            if (profiler.csv != NULL) profile_stop_csv(&profiler);
+            else if (!profile_start_csv(&profiler, profile_path)) fprintf(stderr, "Could not write the profile to %s\n", profile_path);
+        }
         if (!playing) {
-            // Menu state
+            // Menu state, where the music needs a steady stream of frames
+            if (event_waiting) {
+                DisableEventWaiting();
+                event_waiting = false;
+            }
             if (!IsMusicStreamPlaying(menu_music)) PlayMusicStream(menu_music);
             UpdateMusicStream(menu_music);
 
             // Draw menu screen
+            profile_enter(&profiler, PROFILE_RENDER);
             BeginDrawing();
                 ClearBackground(BROWN);
                 
@@ -753,8 +545,8 @@ int main(void)
 
                 // TODO: implement button functionality
                 float button_width = 500.0f;
-                float button_height = 150.0f;
-                float button_down_offset = 40.0f;
+                float button_height = 110.0f;
+                float button_down_offset = 10.0f;
                 Rectangle play_button = {
                     .x = SCREEN_WIDTH/2 - button_width/2,
                     .y = SCREEN_HEIGHT/2 - button_height/2 + button_down_offset,
@@ -763,7 +555,16 @@ int main(void)
                 };
                 DrawButtonWithText(play_button, "Play", 80, DARKBROWN);
 
-                button_down_offset += button_height + 40.0f;
+                button_down_offset += button_height + 30.0f;
+                Rectangle engine_button = {
+                    .x = SCREEN_WIDTH/2 - button_width/2,
+                    .y = SCREEN_HEIGHT/2 - button_height/2 + button_down_offset,
+                    .width = button_width,
+                    .height = button_height
+                };
+                DrawButtonWithText(engine_button, "Play vs bot", 80, DARKBROWN);
+
+                button_down_offset += button_height + 30.0f;
                 Rectangle tutorial_button = {
                     .x = SCREEN_WIDTH/2 - button_width/2,
                     .y = SCREEN_HEIGHT/2 - button_height/2 + button_down_offset,
@@ -791,7 +592,7 @@ int main(void)
                     // Draw tutorial box
                     DrawRectangleRec(tutorial_box, DARKBROWN);
                     DrawButtonWithText(tutorial_close_button, "Close", 80, DARKGRAY);
-                    static const char* text = "When it's your turn, drag and drop pieces to the squares you want to place them. Visual indicators will show where you can place the piece. Alternate turns with a friend!";
+                    static const char* text = "When it's your turn, drag and drop pieces to the squares you want to place them. Visual indicators will show where you can place the piece. Alternate turns with a friend, or play White against the bot!";
                     Rectangle text_area = {
                         .x = tutorial_box.x + tutorial_close_button_padding,
                         .y = tutorial_close_button.y + tutorial_close_button.height + tutorial_close_button_padding,
@@ -801,17 +602,27 @@ int main(void)
                     DrawRectangleRec(text_area, DARKBROWN);
                     DrawTextInRect(text_area, text, 60, papyrus);
                 }
+                if (show_profiler) DrawProfiler(&profiler);
+            profile_enter(&profiler, PROFILE_WAIT);
             EndDrawing();
+            profile_enter(&profiler, PROFILE_INPUT);
 
             // Handle button events
             Vector2 mouse = GetMousePosition();
             if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT)) {
-                if (!tutorial && CheckCollisionPointRec(mouse, play_button)) {
+                if (!tutorial && (CheckCollisionPointRec(mouse, play_button) || CheckCollisionPointRec(mouse, engine_button))) {
                     playing = true;
-                    initialize_game(&ctx);
-                    current_move = 0;
-                    ctx_history[current_move] = ctx;
-                    flush_move_buffer(&possible_moves); // Just to assure that we don't have junk data from a previous game
+                    vs_engine = CheckCollisionPointRec(mouse, engine_button);
+                    load_fen(&ctx, start_fen);
+                    status = board_status(&ctx, &legal_moves);
+                    history_free(&history);
+                    if (!history_init(&history, &ctx)) {
+                        // Nothing can be played without it, so the program ends once this frame is drawn
+                        fprintf(stderr, "Could not allocate the game history\n");
+                        out_of_memory = true;
+                        playing = false;
+                    }
+                    possible_moves.count = 0; // Just to assure that we don't have junk data from a previous game
                     StopMusicStream(menu_music);
                 }
                 if (!tutorial) {
@@ -823,19 +634,46 @@ int main(void)
             }
         } else {
             // Playing state
+            // While the game is being browsed the bot waits, it only plays from the last position
+            bool engine_turn = vs_engine && ctx.accept_move && ctx.turn == engine_player && history.ply == history.length;
+            if (engine_turn) {
+                // The engine thinks on its own thread, we only check on it once per frame
+                if (engine_poll(&engine, &engine_progress) == ENGINE_IDLE) {
+                    engine_start(&engine, &ctx, (SearchLimits) {.time_limit = ENGINE_TIME_LIMIT, .tt = &tt, .threads = threads,
+                                                                .nnue = use_nnue ? &nnue : NULL});
+                } else if (IsKeyPressed(KEY_SPACE)) {
+                    engine_cancel(&engine);
+                } else if (engine_collect(&engine, &move) && move != NO_MOVE) {
+                    board_notation(move, &ctx, &legal_moves, notation);
+                    history_push(&history, &ctx, move);
+                    if (move_type(move) == CAPTURE || move_type(move) == EN_PASSANT) {
+                        PlaySound(capture_sound);
+                    } else {
+                        PlaySound(move_sound);
+                    }
+                    status = board_status(&ctx, &legal_moves);
+                    engine_turn = false;
+                }
+                // A new search counts its nodes from 0 again
+                uint64_t nodes = engine_progress.nodes;
+                profile_count(&profiler, PROFILE_ENGINE_NODES, (nodes >= counted_nodes) ? nodes - counted_nodes : nodes);
+                counted_nodes = nodes;
+            }
+            if (IsKeyPressed(KEY_C) && !ctx.promotion) {
+                // Copies the position as FEN, to set it up in another program or start from it with --fen
+                char fen[FEN_CAP];
+                save_fen(&ctx, fen);
+                SetClipboardText(fen);
+            }
             if (ctx.accept_move) {
                 // Read user input
-                if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && !selected_piece) {
+                if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && !selected_piece && !engine_turn) {
                     Vector2 mouse_pos = GetMousePosition();
                     selected_col = ((int) mouse_pos.x) / SQUARE_SIZE + 1;
                     selected_row = 8 - ((int) mouse_pos.y) / SQUARE_SIZE;
-                    if (selected_col >= A && selected_col <= H && selected_row >= 1 && selected_row <= 8 && ctx.board_at(selected_row, selected_col).type != EMPTY && ctx.board_at(selected_row, selected_col).player == ctx.turn) {
+                    if (selected_col >= A && selected_col <= H && selected_row >= 1 && selected_row <= 8 && player_at(&ctx, selected_row, selected_col) == ctx.turn) {
                         selected_piece = true;
-                        ctx.board_at(selected_row, selected_col).selected = true;
-                        if (!calculated_moves) {
-                            calculate_possible_moves(ctx.board_at(selected_row, selected_col), &possible_moves, ctx);
-                            validate_possible_moves(ctx.board_at(selected_row, selected_col), &possible_moves, ctx);
-                        }
+                        possible_moves = moves_from(current_moves(&ctx, &legal_moves), SQUARE_INDEX(selected_row, selected_col));
                     }
                 } else if (IsMouseButtonReleased(MOUSE_BUTTON_LEFT) && selected_piece) {
                     // Process user input
@@ -843,95 +681,111 @@ int main(void)
                     target_col = ((int) mouse_pos.x) / SQUARE_SIZE + 1;
                     target_row = 8 - ((int) mouse_pos.y) / SQUARE_SIZE;
                     if (target_col >= A && target_col <= H && target_row >= 1 && target_row <= 8 && is_possible(target_row, target_col, possible_moves, &move_index)) {
-                        ctx.moves += 1;
                         move = possible_moves.moves[move_index];
-                        algebraic_notation(move, ctx, notation);
-                        apply_move(move, &ctx);
-                        if (move.type == CAPTURE || move.type == EN_PASSANT) {
+                        board_notation(move, &ctx, &legal_moves, notation);
+                        history_push(&history, &ctx, move);
+                        if (move_type(move) == CAPTURE || move_type(move) == EN_PASSANT) {
                             PlaySound(capture_sound);
                         } else {
                             PlaySound(move_sound);
                         }
-                        ctx.last_move = move;
-                        // Update castling privileges
-                        // TODO: maybe this context updating should be moved to `apply_move`?
-                        if (ctx.board_at(selected_row, selected_col).type == KING || move.type == CASTLES_SHORT || move.type == CASTLES_LONG) {
-                            ctx.can_castle_short[ctx.turn] = false;
-                            ctx.can_castle_long[ctx.turn] = false;
-                        } else if (ctx.board_at(selected_row, selected_col).type == ROOK && selected_row == back_row[ctx.turn] && selected_col == A) {
-                            ctx.can_castle_long[ctx.turn] = false;
-                        } else if (ctx.board_at(selected_row, selected_col).type == ROOK && selected_row == back_row[ctx.turn] && selected_col == H) {
-                            ctx.can_castle_short[ctx.turn] = false;
-                        }
                         
-                        if (move.to.row == back_row[1 - ctx.turn] && ctx.board_at(move.to.row, move.to.col).type == PAWN) {
+                        if (move_promotion(move) != EMPTY) {
+                            // The move was played as a queen promotion, it is replayed once the user picks the piece
                             ctx.promotion = true;
                             ctx.accept_move = false;
                         }
                         
                         if (!ctx.promotion) {
-                            // Remember: all the things here must be done after the user chooses the promotion piece
-                            ctx.turn = 1 - ctx.turn;
-                            // Register context in history
-                            if (current_move < MOVE_HISTORY_CAP) {
-                                current_move += 1;
-                                ctx_history[current_move] = ctx;
-                            }
-                            ctx.check = is_check(ctx);
-                            if (ctx.check) {
-                                ctx.mate = is_mate(ctx);
-                            }
+                            status = board_status(&ctx, &legal_moves);
                         }
-                    } else {
-                        ctx.board_at(selected_row, selected_col).selected = false;
                     }
                     selected_piece = false;
-                    flush_move_buffer(&possible_moves);
+                    possible_moves.count = 0;
                 } else if (IsKeyPressed(KEY_B)) {
-                    // Revert move
-                    if (current_move > 0) current_move -= 1;
-                    ctx = ctx_history[current_move];
+                    // Revert move, and against the bot also its reply
+                    if (engine_turn) engine_abort(&engine);
+                    history_pop(&history, &ctx);
+                    if (vs_engine && history.ply > 0 && ctx.turn == engine_player) history_pop(&history, &ctx);
+                    status = board_status(&ctx, &legal_moves);
+                    if (history.ply > 0) last_move_notation(&history, &ctx, notation);
+                } else if (IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_RIGHT) || IsKeyPressed(KEY_HOME) || IsKeyPressed(KEY_END)) {
+                    // Browse the game: one ply back or forward, or straight to its start or its last move
+                    if (engine_turn) engine_abort(&engine);
+                    size_t ply = history.ply;
+                    if (IsKeyPressed(KEY_LEFT) && ply > 0) ply--;
+                    else if (IsKeyPressed(KEY_RIGHT) && ply < history.length) ply++;
+                    else if (IsKeyPressed(KEY_HOME)) ply = 0;
+                    else if (IsKeyPressed(KEY_END)) ply = history.length;
+                    history_jump(&history, &ctx, ply);
+                    status = board_status(&ctx, &legal_moves);
+                    if (history.ply > 0) last_move_notation(&history, &ctx, notation);
+                } else if (IsKeyPressed(KEY_E) && nnue_loaded(&nnue)) {
+                    // The search restarts on the next frame with the other evaluation
+                    if (engine_turn) engine_abort(&engine);
+                    use_nnue = !use_nnue;
+                } else if (IsKeyPressed(KEY_H)) {
+                    show_hanging = !show_hanging;
                 }
-                if (ctx.mate) ctx.accept_move = false;
+                if (status != GAME_ONGOING) ctx.accept_move = false;
             } else {
                 // Handle cases where we don't accept standard user input
-                if (ctx.mate && IsKeyPressed(KEY_ENTER)) playing = false;
+                if (status != GAME_ONGOING && IsKeyPressed(KEY_ENTER)) playing = false;
                 if (ctx.promotion) {
-                    if (IsKeyPressed(KEY_Q)) {
-                        ctx.board_at(move.to.row, move.to.col) = (Piece) {.type = QUEEN, .row = move.to.row, .col = move.to.col, .player = ctx.turn};
-                        ctx.promotion = false;
-                    } else if (IsKeyPressed(KEY_R)) {
-                        ctx.board_at(move.to.row, move.to.col) = (Piece) {.type = ROOK, .row = move.to.row, .col = move.to.col, .player = ctx.turn};
-                        ctx.promotion = false;
-                    } else if (IsKeyPressed(KEY_N)) {
-                        ctx.board_at(move.to.row, move.to.col) = (Piece) {.type = KNIGHT, .row = move.to.row, .col = move.to.col, .player = ctx.turn};
-                        ctx.promotion = false;
-                    } else if (IsKeyPressed(KEY_B)) {
-                        ctx.board_at(move.to.row, move.to.col) = (Piece) {.type = BISHOP, .row = move.to.row, .col = move.to.col, .player = ctx.turn};
+                    PieceType promotion = EMPTY;
+                    if (IsKeyPressed(KEY_Q)) promotion = QUEEN;
+                    else if (IsKeyPressed(KEY_R)) promotion = ROOK;
+                    else if (IsKeyPressed(KEY_N)) promotion = KNIGHT;
+                    else if (IsKeyPressed(KEY_B)) promotion = BISHOP;
+                    if (promotion != EMPTY) {
+                        history_pop(&history, &ctx);
+                        move = encode_move(move_from(move), move_to(move), move_type(move), promotion);
+                        board_notation(move, &ctx, &legal_moves, notation);
+                        history_push(&history, &ctx, move);
                         ctx.promotion = false;
-                    }
-                    if (!ctx.promotion) {
                         ctx.accept_move = true;
-                        ctx.turn = 1 - ctx.turn;
-                        ctx.check = is_check(ctx);
-                        if (ctx.check) {
-                            ctx.mate = is_mate(ctx);
-                        }
+                        status = board_status(&ctx, &legal_moves);
                     }
                 }
             }
 
+            // A dragged piece follows the mouse and the bot reports its progress a few times per second. Otherwise
+            // nothing moves on screen without input, which can be waited for.
+            bool bot_to_move = vs_engine && ctx.accept_move && ctx.turn == engine_player && history.ply == history.length;
+            bool idle = !selected_piece && !bot_to_move;
+            if (idle != event_waiting) {
+                if (idle) EnableEventWaiting(); else DisableEventWaiting();
+                event_waiting = idle;
+            }
+            int fps = bot_to_move ? THINKING_FPS : TARGET_FPS;
+            if (fps != target_fps) {
+                SetTargetFPS(fps);
+                target_fps = fps;
+            }
+
             // Render playing state
+            profile_enter(&profiler, PROFILE_RENDER);
             BeginDrawing();
-                DrawBackground();
-                DrawPieces(ctx, piece_texture);
-                if (ctx.mate) {
-                    char* win_msg = (ctx.turn == WH) ? "Black wins!" : "White wins!";
+                DrawBackground(board_texture);
+                if (show_hanging && status == GAME_ONGOING) DrawHangingPieces(hanging_pieces(&ctx, ctx.turn));
+                DrawPieces(&ctx, piece_texture, selected_piece ? &(Square) {.row = selected_row, .col = selected_col} : NULL);
+                if (status != GAME_ONGOING) {
+                    char* win_msg = "Draw!";
+                    if (status == GAME_CHECKMATE) win_msg = (ctx.turn == WH) ? "Black wins!" : "White wins!";
+                    const char* reasons[] = {
+                        [GAME_CHECKMATE] = "by checkmate",
+                        [GAME_STALEMATE] = "by stalemate",
+                        [GAME_DRAW_REPETITION] = "by repetition",
+                        [GAME_DRAW_FIFTY_MOVES] = "by the 50 move rule",
+                        [GAME_DRAW_MATERIAL] = "no mating material",
+                    };
                     int pad = 50;
                     Vector2 win_msg_pos = { .x = BOARD_SIZE + pad, .y = SCREEN_HEIGHT / 2 - 30};
+                    Vector2 reason_pos = { .x = BOARD_SIZE + pad, .y = SCREEN_HEIGHT / 2 + 40};
                     float size = 60.0f;
                     float spacing = 5.0f;
                     DrawTextEx(papyrus, win_msg, win_msg_pos, size, spacing, WHITE);
+                    DrawTextEx(papyrus, reasons[status], reason_pos, 40.0f, spacing, WHITE);
                     char* prompt = "Press ENTER to go";
                     char* prompt2 = "back to menu";
                     Vector2 prompt_pos = { .x = BOARD_SIZE + 10, .y = SCREEN_HEIGHT / 2 + 150};
@@ -941,12 +795,7 @@ int main(void)
                 } else {
                     if (selected_piece && possible_moves.count > 0) DrawPossibleMoves(possible_moves);
                     char last_move_msg[64];
-                    if (ctx.turn == WH){
-                        strcpy(last_move_msg, "Black played ");
-                    } else {
-                        strcpy(last_move_msg, "White played ");
-                    }
-                    strcpy(&last_move_msg[13], notation);
+                    snprintf(last_move_msg, sizeof(last_move_msg), "%s played %s", (ctx.turn == WH) ? "Black" : "White", notation);
                     char* turn_msg = (ctx.turn == WH) ? "White to play" : "Black to play";
                     int pad = 50;
                     Vector2 turn_msg_pos = { .x = BOARD_SIZE + 1.3*pad, .y = 0.85*SCREEN_HEIGHT};
@@ -954,9 +803,31 @@ int main(void)
                     float size = 60.0f;
                     float spacing = 5.0f;
                     if (ctx.moves > 0) {
-                        DrawTextEx(papyrus, last_move_msg, last_move_msg_pos, size, spacing, WHITE);
+                        DrawTextLayout(layout_text(papyrus, last_move_msg, size, spacing, 0), papyrus, last_move_msg_pos, WHITE);
+                    }
+                    DrawTextLayout(layout_text(papyrus, turn_msg, size, spacing, 0), papyrus, turn_msg_pos, WHITE);
+
+                    if (engine_turn) {
+                        char engine_msg[64];
+                        char pv_msg[64] = "PV";
+                        char hash_msg[64];
+                        TTStats tt_info;
+                        tt_stats(&tt, &tt_info);
+                        snprintf(engine_msg, sizeof(engine_msg), "Depth %d   %llu nodes", engine_progress.depth, (unsigned long long) engine_progress.nodes);
+                        snprintf(hash_msg, sizeof(hash_msg), "Hash %zu MB   %d.%d%% full", tt_info.size_mb, tt_info.hashfull/10, tt_info.hashfull%10);
+                        for (int i = 0; i < engine_progress.pv_length && i < 4; i++) {
+                            char text[6];
+                            move_to_uci(engine_progress.pv[i], text);
+                            strcat(pv_msg, " ");
+                            strcat(pv_msg, text);
+                        }
+                        DrawTextEx(papyrus, "Thinking...", (Vector2) {.x = BOARD_SIZE + 10, .y = 10}, 40.0f, spacing, WHITE);
+                        DrawTextEx(papyrus, engine_msg, (Vector2) {.x = BOARD_SIZE + 10, .y = 50}, 36.0f, spacing, WHITE);
+                        DrawTextEx(papyrus, pv_msg, (Vector2) {.x = BOARD_SIZE + 10, .y = 90}, 36.0f, spacing, WHITE);
+                        DrawTextEx(papyrus, hash_msg, (Vector2) {.x = BOARD_SIZE + 10, .y = 130}, 36.0f, spacing, WHITE);
+                        DrawTextEx(papyrus, use_nnue ? "Evaluation: NNUE" : "Evaluation: classical", (Vector2) {.x = BOARD_SIZE + 10, .y = 170}, 36.0f, spacing, WHITE);
+                        DrawTextEx(papyrus, "Press SPACE to move now", (Vector2) {.x = BOARD_SIZE + 10, .y = 230}, 36.0f, spacing, WHITE);
                     }
-                    DrawTextEx(papyrus, turn_msg, turn_msg_pos, size, spacing, WHITE);
 
                     if (ctx.check) {
                         char* check_msg = "In check";
@@ -977,11 +848,19 @@ int main(void)
                         }
                     }
                 }
+                if (show_profiler) DrawProfiler(&profiler);
+            profile_enter(&profiler, PROFILE_WAIT);
             EndDrawing();
         }
     }
+    profile_stop_csv(&profiler);
+    engine_shutdown(&engine);
+    history_free(&history);
+    nnue_free(&nnue);
+    tt_free(&tt);
+    UnloadRenderTexture(board_texture);
     UnloadMusicStream(menu_music);
     CloseAudioDevice();
     CloseWindow();
-    return 0;
+    return out_of_memory ? 1 : 0;
 }
\ No newline at end of file
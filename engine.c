@@ -0,0 +1,123 @@
+#include "engine.h"
+
+void engine_report(const SearchResult *progress, void *data)
+{
+    EngineJob *job = data;
+    pthread_mutex_lock(&job->lock);
+    job->progress = *progress;
+    void (*forward)(const SearchResult *, void *) = job->limits.report;
+    void *forward_data = job->limits.report_data;
+    pthread_mutex_unlock(&job->lock);
+    if (forward != NULL) forward(progress, forward_data);
+}
+
+// Runs the search the job was given. Called with the lock held and the job THINKING, returns with it held and DONE.
+void engine_run(EngineJob *job)
+{
+    GameContext ctx = job->ctx;
+    SearchLimits limits = job->limits;
+    limits.stop = &job->stop;
+    limits.report = engine_report;
+    limits.report_data = job;
+    pthread_mutex_unlock(&job->lock);
+
+    SearchResult result;
+    search(&ctx, limits, &result);
+    if (job->on_done != NULL) job->on_done(&result, job->on_done_data);
+
+    pthread_mutex_lock(&job->lock);
+    job->progress = result;
+    job->status = ENGINE_DONE;
+    pthread_cond_broadcast(&job->finished);
+}
+
+void *engine_main(void *data)
+{
+    EngineJob *job = data;
+    pthread_mutex_lock(&job->lock);
+    while (true) {
+        while (job->status != ENGINE_THINKING && !job->quit) pthread_cond_wait(&job->wake, &job->lock);
+        if (job->quit) break;
+        engine_run(job);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+bool engine_init(EngineJob *job)
+{
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->wake, NULL);
+    pthread_cond_init(&job->finished, NULL);
+    job->status = ENGINE_IDLE;
+    job->quit = false;
+    job->on_done = NULL;
+    job->on_done_data = NULL;
+    atomic_init(&job->stop, false);
+    job->threaded = pthread_create(&job->thread, NULL, engine_main, job) == 0;
+    return job->threaded;
+}
+
+void engine_shutdown(EngineJob *job)
+{
+    atomic_store(&job->stop, true);
+    pthread_mutex_lock(&job->lock);
+    job->quit = true;
+    pthread_cond_signal(&job->wake);
+    pthread_mutex_unlock(&job->lock);
+    if (job->threaded) pthread_join(job->thread, NULL);
+    pthread_cond_destroy(&job->wake);
+    pthread_cond_destroy(&job->finished);
+    pthread_mutex_destroy(&job->lock);
+}
+
+void engine_start(EngineJob *job, const GameContext *ctx, SearchLimits limits)
+{
+    pthread_mutex_lock(&job->lock);
+    if (job->status == ENGINE_IDLE) {
+        job->ctx = *ctx;
+        job->limits = limits;
+        job->progress = (SearchResult) {0};
+        atomic_store(&job->stop, false);
+        job->status = ENGINE_THINKING;
+        if (job->threaded) pthread_cond_signal(&job->wake);
+        else engine_run(job);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+EngineStatus engine_poll(EngineJob *job, SearchResult *progress)
+{
+    pthread_mutex_lock(&job->lock);
+    EngineStatus status = job->status;
+    if (progress != NULL) *progress = job->progress;
+    pthread_mutex_unlock(&job->lock);
+    return status;
+}
+
+void engine_cancel(EngineJob *job)
+{
+    atomic_store(&job->stop, true);
+}
+
+bool engine_collect(EngineJob *job, Move *move)
+{
+    bool done;
+    pthread_mutex_lock(&job->lock);
+    done = job->status == ENGINE_DONE;
+    if (done) {
+        *move = job->progress.best_move;
+        job->status = ENGINE_IDLE;
+    }
+    pthread_mutex_unlock(&job->lock);
+    return done;
+}
+
+void engine_abort(EngineJob *job)
+{
+    atomic_store(&job->stop, true);
+    pthread_mutex_lock(&job->lock);
+    while (job->status == ENGINE_THINKING) pthread_cond_wait(&job->finished, &job->lock);
+    job->status = ENGINE_IDLE;
+    pthread_mutex_unlock(&job->lock);
+}
@@ -0,0 +1,48 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include <pthread.h>
+
+#include "search.h"
+
+typedef enum {
+    ENGINE_IDLE, ENGINE_THINKING, ENGINE_DONE
+} EngineStatus;
+
+// A search running on its own thread, so that the caller (the render loop) never waits for it.
+// Everything below `lock` is shared with the worker and must only be touched through the functions.
+typedef struct {
+    pthread_t thread;
+    bool threaded;          // False if the worker couldn't be started, then searches run in `engine_start`
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t finished;
+    EngineStatus status;
+    bool quit;
+    GameContext ctx;        // The job's own copy of the position
+    SearchLimits limits;
+    SearchResult progress;  // Latest report of the running search, or its final result once done
+    atomic_bool stop;
+    // If not NULL, called from the worker with the final result when a search is over, before the job becomes DONE
+    void (*on_done)(const SearchResult *result, void *data);
+    void *on_done_data;
+} EngineJob;
+
+// Returns false if the worker thread couldn't be created. The job still works, but `engine_start` then
+// searches on the caller's thread and only returns once the search is over.
+bool engine_init(EngineJob *job);
+void engine_shutdown(EngineJob *job);
+
+// Starts searching `ctx` in the background. Does nothing if a search is already running.
+// `limits.report`, if set, is called from the worker thread on top of the job's own progress tracking.
+void engine_start(EngineJob *job, const GameContext *ctx, SearchLimits limits);
+// Copies the latest progress into `progress` (if not NULL) and tells whether the search is over
+EngineStatus engine_poll(EngineJob *job, SearchResult *progress);
+// Asks the search to stop as soon as possible. It still finishes as usual, with the best move found so far.
+void engine_cancel(EngineJob *job);
+// Takes the best move of a finished search and makes the job idle again. Returns false while still thinking.
+bool engine_collect(EngineJob *job, Move *move);
+// Stops the search, waits for it and throws its result away, for when the position it was given no longer matters
+void engine_abort(EngineJob *job);
+
+#endif // ENGINE_H_
@@ -0,0 +1,184 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+#define LINE_CAP 1024
+#define ID_CAP 64
+#define EPD_MOVES_CAP 8
+#define DEFAULT_TIME_LIMIT 1.0
+#define WORKER_HASH_MB 16
+
+typedef struct {
+    GameContext ctx;
+    char id[ID_CAP];
+    Move best[EPD_MOVES_CAP];       // "bm": the position is solved by playing any of these
+    unsigned int best_count;
+    Move avoid[EPD_MOVES_CAP];      // "am": the position is solved by playing none of these
+    unsigned int avoid_count;
+    SearchResult result;
+    bool solved;
+} EpdPosition;
+
+typedef struct {
+    EpdPosition *positions;
+    size_t count;
+    atomic_size_t next;             // Index of the next position a worker takes
+    double time_limit;
+} EpdSuite;
+
+static bool contains(const Move *moves, unsigned int count, Move move)
+{
+    for (unsigned int i = 0; i < count; i++) {
+        if (moves[i] == move) return true;
+    }
+    return false;
+}
+
+// Reads the moves of a "bm" or "am" operation, up to the ';' that ends it
+const char *parse_moves(EpdPosition *position, const char *ops, Move *moves, unsigned int *count)
+{
+    while (*ops != ';' && *ops != '\0') {
+        while (*ops == ' ') ops++;
+        size_t length = strcspn(ops, " ;");
+        if (length == 0) break;
+        char san[16];
+        snprintf(san, sizeof(san), "%.*s", (int) length, ops);
+        Move move;
+        if (*count < EPD_MOVES_CAP && parse_san(&position->ctx, san, &move)) moves[(*count)++] = move;
+        else fprintf(stderr, "Ignoring move %s of %s\n", san, position->id[0] ? position->id : "a position");
+        ops += length;
+    }
+    return ops;
+}
+
+bool parse_epd(EpdPosition *position, const char *line)
+{
+    memset(position, 0, sizeof(*position));
+    if (!load_fen(&position->ctx, line)) return false;
+
+    // The operations come after the four position fields
+    const char *ops = line;
+    for (int field = 0; field < 4 && ops != NULL; field++) {
+        ops = strchr(ops, ' ');
+        if (ops != NULL) while (*ops == ' ') ops++;
+    }
+    if (ops == NULL) return true;
+
+    // The id usually comes last, but is nice to have in the messages about the moves
+    const char *id = strstr(ops, "id \"");
+    if (id != NULL) snprintf(position->id, sizeof(position->id), "%.*s", (int) strcspn(id + 4, "\""), id + 4);
+
+    while (*ops != '\0') {
+        while (*ops == ' ' || *ops == ';') ops++;
+        if (strncmp(ops, "bm ", 3) == 0) {
+            ops = parse_moves(position, ops + 3, position->best, &position->best_count);
+        } else if (strncmp(ops, "am ", 3) == 0) {
+            ops = parse_moves(position, ops + 3, position->avoid, &position->avoid_count);
+        } else {
+            // Other operations are skipped, minding the quoted strings which may contain ';'
+            bool quoted = false;
+            for (; *ops != '\0' && (quoted || *ops != ';'); ops++) if (*ops == '"') quoted = !quoted;
+        }
+    }
+    return true;
+}
+
+void *worker_main(void *data)
+{
+    EpdSuite *suite = data;
+    TranspositionTable tt = {0};
+    if (!tt_init(&tt, WORKER_HASH_MB, false)) return NULL;
+
+    size_t i;
+    while ((i = atomic_fetch_add(&suite->next, 1)) < suite->count) {
+        EpdPosition *position = &suite->positions[i];
+        // Positions are unrelated, so one must not profit from what was searched for another
+        tt_clear(&tt);
+        Move move = search(&position->ctx, (SearchLimits) {.time_limit = suite->time_limit, .tt = &tt}, &position->result);
+        position->solved = (position->best_count > 0 || position->avoid_count > 0) &&
+                           (position->best_count == 0 || contains(position->best, position->best_count, move)) &&
+                           !contains(position->avoid, position->avoid_count, move);
+    }
+    tt_free(&tt);
+    return NULL;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s <file.epd> [seconds per position] [threads]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 4) {
+        usage(argv[0]);
+        return 1;
+    }
+    double time_limit = (argc > 2) ? atof(argv[2]) : DEFAULT_TIME_LIMIT;
+    int threads = (argc > 3) ? atoi(argv[3]) : 1;
+    if (time_limit <= 0 || threads < 1 || threads > MAX_THREADS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+    init_tables();
+
+    EpdSuite suite = {.time_limit = time_limit};
+    size_t capacity = 0;
+    char line[LINE_CAP];
+    size_t line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        if (suite.count == capacity) {
+            capacity = (capacity == 0) ? 64 : 2*capacity;
+            suite.positions = realloc(suite.positions, capacity*sizeof(EpdPosition));
+            if (suite.positions == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+        }
+        if (parse_epd(&suite.positions[suite.count], line)) suite.count++;
+        else fprintf(stderr, "Skipping invalid position on line %zu\n", line_number);
+    }
+    fclose(file);
+    atomic_init(&suite.next, 0);
+
+    // Each worker solves whole positions with one search thread, which scales better than sharing every search
+    pthread_t *workers = malloc(threads*sizeof(pthread_t));
+    double start = clock_seconds();
+    for (int i = 0; i < threads; i++) pthread_create(&workers[i], NULL, worker_main, &suite);
+    for (int i = 0; i < threads; i++) pthread_join(workers[i], NULL);
+    double elapsed = clock_seconds() - start;
+    free(workers);
+
+    size_t solved = 0;
+    uint64_t nodes = 0;
+    double search_time = 0;
+    for (size_t i = 0; i < suite.count; i++) {
+        EpdPosition *position = &suite.positions[i];
+        char text[6];
+        move_to_uci(position->result.best_move, text);
+        printf("%-24s %-6s depth %2d score %6d %s\n", position->id[0] ? position->id : "-", text,
+               position->result.depth, position->result.score, position->solved ? "solved" : "");
+        solved += position->solved;
+        nodes += position->result.nodes;
+        search_time += position->result.elapsed;
+    }
+
+    printf("\nSolved %zu/%zu positions with %.3f s each on %d threads\n", solved, suite.count, time_limit, threads);
+    printf("Time: %.3f s\n", elapsed);
+    printf("Nodes: %llu\n", (unsigned long long) nodes);
+    printf("NPS: %.0f per thread, %.0f total\n", search_time > 0 ? nodes/search_time : 0.0, elapsed > 0 ? nodes/elapsed : 0.0);
+    free(suite.positions);
+    return 0;
+}
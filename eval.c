@@ -0,0 +1,29 @@
+#include "eval.h"
+
+int evaluate(const GameContext *ctx)
+{
+    const EvalTerms *eval = &ctx->eval;
+    int score = taper(eval->material_mg + eval->psq_mg, eval->material_eg + eval->psq_eg, eval->phase);
+    return (ctx->turn == WH) ? score : -score;
+}
+
+void print_evaluation(const GameContext *ctx, FILE *out)
+{
+    const EvalTerms *eval = &ctx->eval;
+    int phase = (eval->phase < PHASE_MAX) ? eval->phase : PHASE_MAX;
+    fprintf(out, "%-16s %8s %8s %8s\n", "term (white)", "mg", "eg", "blended");
+    fprintf(out, "%-16s %8d %8d %8d\n", "material", eval->material_mg, eval->material_eg,
+            taper(eval->material_mg, eval->material_eg, eval->phase));
+    fprintf(out, "%-16s %8d %8d %8d\n", "piece-square", eval->psq_mg, eval->psq_eg,
+            taper(eval->psq_mg, eval->psq_eg, eval->phase));
+    fprintf(out, "%-16s %8d %8d %8d\n", "total", eval->material_mg + eval->psq_mg, eval->material_eg + eval->psq_eg,
+            taper(eval->material_mg + eval->psq_mg, eval->material_eg + eval->psq_eg, eval->phase));
+    fprintf(out, "phase %d/%d, %d for the side to move\n", phase, PHASE_MAX, evaluate(ctx));
+
+    EvalTerms recount = compute_eval(ctx);
+    if (recount.material_mg != eval->material_mg || recount.material_eg != eval->material_eg || recount.psq_mg != eval->psq_mg
+        || recount.psq_eg != eval->psq_eg || recount.phase != eval->phase) {
+        fprintf(out, "incremental terms out of sync, a recount gives %d %d %d %d phase %d\n", recount.material_mg,
+                recount.material_eg, recount.psq_mg, recount.psq_eg, recount.phase);
+    }
+}
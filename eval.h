@@ -0,0 +1,22 @@
+#ifndef EVAL_H_
+#define EVAL_H_
+
+#include <stdio.h>
+
+#include "rules.h"
+
+// Blends a middlegame and an endgame score by how many pieces are left
+static inline int taper(int mg, int eg, int phase)
+{
+    if (phase > PHASE_MAX) phase = PHASE_MAX;
+    return (mg*phase + eg*(PHASE_MAX - phase))/PHASE_MAX;
+}
+
+// Static evaluation from the point of view of the side to move, in centipawns. The board keeps the sums
+// of material and piece-square values up to date on every move, so this only blends them.
+int evaluate(const GameContext *ctx);
+
+// Prints every term for both phases and blended, and checks the incremental sums against a recount
+void print_evaluation(const GameContext *ctx, FILE *out);
+
+#endif // EVAL_H_
@@ -0,0 +1,80 @@
+#include "file_map.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+bool map_file(FileMap *map, const char *path)
+{
+    LARGE_INTEGER size;
+    map->data = NULL;
+    map->size = 0;
+    map->mapping = NULL;
+    map->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (map->file == INVALID_HANDLE_VALUE) return false;
+    if (!GetFileSizeEx(map->file, &size)) {
+        CloseHandle(map->file);
+        return false;
+    }
+    map->size = size.QuadPart;
+    // Empty files can't be mapped, but are valid (and empty) inputs
+    if (map->size == 0) return true;
+    map->mapping = CreateFileMappingA(map->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (map->mapping != NULL) map->data = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (map->data == NULL) {
+        unmap_file(map);
+        return false;
+    }
+    return true;
+}
+
+void unmap_file(FileMap *map)
+{
+    if (map->data != NULL) UnmapViewOfFile(map->data);
+    if (map->mapping != NULL) CloseHandle(map->mapping);
+    if (map->file != INVALID_HANDLE_VALUE) CloseHandle(map->file);
+    map->data = NULL;
+    map->size = 0;
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool map_file(FileMap *map, const char *path)
+{
+    struct stat info;
+    map->data = NULL;
+    map->size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return false;
+    }
+    map->size = info.st_size;
+    // Empty files can't be mapped, but are valid (and empty) inputs
+    if (map->size > 0) {
+        void *data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            map->size = 0;
+            return false;
+        }
+        // Read front to back: read ahead aggressively and drop the pages behind
+        madvise(data, map->size, MADV_SEQUENTIAL);
+        map->data = data;
+    }
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    return true;
+}
+
+void unmap_file(FileMap *map)
+{
+    if (map->data != NULL) munmap((void *) map->data, map->size);
+    map->data = NULL;
+    map->size = 0;
+}
+#endif
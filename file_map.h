@@ -0,0 +1,20 @@
+#ifndef FILE_MAP_H_
+#define FILE_MAP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A whole file mapped read-only into memory. The kernel pages it in as it is read, so the file may be larger than RAM.
+typedef struct {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    void *file;
+    void *mapping;
+#endif
+} FileMap;
+
+bool map_file(FileMap *map, const char *path);
+void unmap_file(FileMap *map);
+
+#endif // FILE_MAP_H_
@@ -0,0 +1,98 @@
+#include <string.h>
+
+#include "gamedb.h"
+
+static inline size_t padded(size_t length)
+{
+    return (length + 1) & ~(size_t) 1;
+}
+
+bool gamedb_is_database(const char *data, size_t size)
+{
+    return size >= sizeof(GameDbHeader) && memcmp(data, GAMEDB_MAGIC, 4) == 0;
+}
+
+bool gamedb_reader_init(GameDbReader *reader, const char *data, size_t size)
+{
+    if (!gamedb_is_database(data, size)) return false;
+    GameDbHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (header.version != GAMEDB_VERSION) return false;
+    reader->cursor = data + sizeof(header);
+    reader->end = data + size;
+    return true;
+}
+
+// Size of the game starting at `p`, or 0 if it doesn't fit before `end`
+static size_t record_size(const char *p, const char *end)
+{
+    if ((size_t) (end - p) < sizeof(GameRecord)) return 0;
+    const GameRecord *record = (const GameRecord *) p;
+    size_t size = sizeof(GameRecord) + padded(record->fen_length) + record->ply_count*sizeof(Move);
+    return (size <= (size_t) (end - p)) ? size : 0;
+}
+
+size_t gamedb_split(const GameDbReader *reader, size_t parts, GameDbReader *readers)
+{
+    const char *begin = reader->cursor, *p = reader->cursor, *end = reader->end;
+    size_t count = 0;
+    for (size_t i = 1; i <= parts && begin < end; i++) {
+        // Hop over whole records until this part has its share of the bytes
+        const char *target = (i < parts) ? reader->cursor + (end - reader->cursor)/parts*i : end;
+        size_t size = 1;
+        while (p < target && (size = record_size(p, end)) != 0) p += size;
+        if (i == parts || size == 0) p = end;
+        if (p > begin) readers[count++] = (GameDbReader) {.cursor = begin, .end = p};
+        begin = p;
+    }
+    return count;
+}
+
+bool gamedb_next_game(GameDbReader *reader, GameDbGame *game)
+{
+    size_t size = record_size(reader->cursor, reader->end);
+    if (size == 0) {
+        reader->cursor = reader->end;
+        return false;
+    }
+    const GameRecord *record = (const GameRecord *) reader->cursor;
+    game->start = reader->cursor;
+    game->result = record->result;
+    game->fen_length = record->fen_length;
+    game->fen = (record->fen_length > 0) ? reader->cursor + sizeof(GameRecord) : NULL;
+    game->moves = (const Move *) (reader->cursor + sizeof(GameRecord) + padded(record->fen_length));
+    game->ply_count = record->ply_count;
+    reader->cursor += size;
+    return true;
+}
+
+bool gamedb_start_position(const GameDbGame *game, GameContext *ctx)
+{
+    if (game->fen == NULL) {
+        initialize_game(ctx);
+        return true;
+    }
+    char fen[FEN_CAP];
+    if (game->fen_length >= FEN_CAP) return false;
+    memcpy(fen, game->fen, game->fen_length);
+    fen[game->fen_length] = '\0';
+    return load_fen(ctx, fen);
+}
+
+bool gamedb_write_header(FILE *file)
+{
+    GameDbHeader header = {.magic = GAMEDB_MAGIC, .version = GAMEDB_VERSION};
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+bool gamedb_write_game(FILE *file, const char *fen, size_t fen_length, GameResult result, const Move *moves, size_t ply_count)
+{
+    if (fen == NULL) fen_length = 0;
+    if (fen_length >= FEN_CAP || ply_count > GAMEDB_MAX_PLIES) return false;
+    GameRecord record = {.ply_count = ply_count, .result = result, .fen_length = fen_length};
+    char padding = 0;
+    if (fwrite(&record, sizeof(record), 1, file) != 1) return false;
+    if (fen_length > 0 && fwrite(fen, 1, fen_length, file) != fen_length) return false;
+    if (fen_length%2 == 1 && fwrite(&padding, 1, 1, file) != 1) return false;
+    return fwrite(moves, sizeof(Move), ply_count, file) == ply_count;
+}
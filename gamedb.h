@@ -0,0 +1,55 @@
+#ifndef GAMEDB_H_
+#define GAMEDB_H_
+
+#include <stdio.h>
+
+#include "rules.h"
+
+// Binary game database: a GameDbHeader, then every game one after the other as a GameRecord, the FEN of its
+// start position if it has one (padded to an even length) and its moves as stored in memory. Meant to be
+// memory-mapped and replayed as is, without any parsing. Numbers are little-endian.
+#define GAMEDB_MAGIC "PCDB"
+#define GAMEDB_VERSION 1
+#define GAMEDB_MAX_PLIES 65535
+
+typedef enum {
+    RESULT_UNKNOWN, RESULT_WHITE_WINS, RESULT_BLACK_WINS, RESULT_DRAW
+} GameResult;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+} GameDbHeader;
+
+typedef struct {
+    uint16_t ply_count;
+    uint8_t result;         // GameResult
+    uint8_t fen_length;     // 0 when the game starts from the usual position
+} GameRecord;
+
+typedef struct {
+    const char *cursor;
+    const char *end;
+} GameDbReader;
+
+typedef struct {
+    const char *start;      // First byte of the record, for error messages
+    GameResult result;
+    const char *fen;        // Not terminated, `fen_length` long, NULL for the usual start position
+    size_t fen_length;
+    const Move *moves;      // Points into the database
+    size_t ply_count;
+} GameDbGame;
+
+bool gamedb_is_database(const char *data, size_t size);
+// Checks the header and prepares to read the games that follow it
+bool gamedb_reader_init(GameDbReader *reader, const char *data, size_t size);
+// Cuts the games into at most `parts` readers of about the same size. Returns how many it made.
+size_t gamedb_split(const GameDbReader *reader, size_t parts, GameDbReader *readers);
+bool gamedb_next_game(GameDbReader *reader, GameDbGame *game);
+bool gamedb_start_position(const GameDbGame *game, GameContext *ctx);
+
+bool gamedb_write_header(FILE *file);
+bool gamedb_write_game(FILE *file, const char *fen, size_t fen_length, GameResult result, const Move *moves, size_t ply_count);
+
+#endif // GAMEDB_H_
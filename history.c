@@ -0,0 +1,104 @@
+#include <stdlib.h>
+
+#include "history.h"
+
+#define HISTORY_INITIAL_CAPACITY 256
+
+bool history_init(GameHistory *history, const GameContext *ctx)
+{
+    history->moves = malloc(HISTORY_INITIAL_CAPACITY*sizeof(Move));
+    history->undos = malloc(HISTORY_INITIAL_CAPACITY*sizeof(Undo));
+    history->checkpoints = malloc(HISTORY_INITIAL_CAPACITY/HISTORY_CHECKPOINT_INTERVAL*sizeof(GameContext));
+    history->ply = 0;
+    history->length = 0;
+    history->capacity = HISTORY_INITIAL_CAPACITY;
+    history->checkpoint_count = 1;
+    history->checkpoint_capacity = HISTORY_INITIAL_CAPACITY/HISTORY_CHECKPOINT_INTERVAL;
+    if (history->moves == NULL || history->undos == NULL || history->checkpoints == NULL) {
+        history_free(history);
+        return false;
+    }
+    history->checkpoints[0] = *ctx;
+    return true;
+}
+
+void history_free(GameHistory *history)
+{
+    free(history->moves);
+    free(history->undos);
+    free(history->checkpoints);
+    history->moves = NULL;
+    history->undos = NULL;
+    history->checkpoints = NULL;
+    history->ply = history->length = history->capacity = 0;
+    history->checkpoint_count = history->checkpoint_capacity = 0;
+}
+
+static bool grow(GameHistory *history)
+{
+    size_t capacity = 2*history->capacity;
+    Move *moves = realloc(history->moves, capacity*sizeof(Move));
+    if (moves == NULL) return false;
+    history->moves = moves;
+    Undo *undos = realloc(history->undos, capacity*sizeof(Undo));
+    if (undos == NULL) return false;
+    history->undos = undos;
+    history->capacity = capacity;
+    return true;
+}
+
+bool history_push(GameHistory *history, GameContext *ctx, Move move)
+{
+    if (history->ply == history->capacity && !grow(history)) return false;
+    size_t ply = history->ply + 1;
+    if (ply%HISTORY_CHECKPOINT_INTERVAL == 0 && ply/HISTORY_CHECKPOINT_INTERVAL == history->checkpoint_capacity) {
+        size_t capacity = 2*history->checkpoint_capacity;
+        GameContext *checkpoints = realloc(history->checkpoints, capacity*sizeof(GameContext));
+        if (checkpoints == NULL) return false;
+        history->checkpoints = checkpoints;
+        history->checkpoint_capacity = capacity;
+    }
+
+    make_move(ctx, move, &history->undos[history->ply]);
+    history->moves[history->ply] = move;
+    history->ply = ply;
+    history->length = ply;
+    ctx->moves = ply;
+    // make_move leaves `check` for the caller to work out, but the checkpoints and undos must hold a consistent context
+    ctx->check = is_check(ctx);
+    if (ply%HISTORY_CHECKPOINT_INTERVAL == 0) history->checkpoints[ply/HISTORY_CHECKPOINT_INTERVAL] = *ctx;
+    // Checkpoints past the new end belonged to the moves that were just forgotten
+    history->checkpoint_count = ply/HISTORY_CHECKPOINT_INTERVAL + 1;
+    return true;
+}
+
+Move history_pop(GameHistory *history, GameContext *ctx)
+{
+    if (history->ply == 0) return NO_MOVE;
+    history->ply--;
+    Move move = history->moves[history->ply];
+    unmake_move(ctx, move, &history->undos[history->ply]);
+    ctx->moves = history->ply;
+    return move;
+}
+
+void history_jump(GameHistory *history, GameContext *ctx, size_t ply)
+{
+    if (ply > history->length) ply = history->length;
+    // Walking there is cheaper than restoring a checkpoint when the target is close, and backwards needs nothing else
+    size_t checkpoint = ply/HISTORY_CHECKPOINT_INTERVAL;
+    if (ply < history->ply && history->ply - ply <= ply - checkpoint*HISTORY_CHECKPOINT_INTERVAL) {
+        while (history->ply > ply) history_pop(history, ctx);
+    } else {
+        if (ply < history->ply || ply - history->ply > ply - checkpoint*HISTORY_CHECKPOINT_INTERVAL) {
+            *ctx = history->checkpoints[checkpoint];
+            history->ply = checkpoint*HISTORY_CHECKPOINT_INTERVAL;
+        }
+        for (; history->ply < ply; history->ply++) {
+            make_move(ctx, history->moves[history->ply], &history->undos[history->ply]);
+            ctx->check = is_check(ctx); // Saved by the next undo, to be restored when this move is taken back
+        }
+    }
+    ctx->moves = ply;
+    ctx->check = is_check(ctx);
+}
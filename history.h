@@ -0,0 +1,34 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include "rules.h"
+
+// Positions are copied every this many plies, so that jumping anywhere replays at most this many moves
+#define HISTORY_CHECKPOINT_INTERVAL 32
+
+// The moves of a game and what it takes to undo them, growing as needed. Going back keeps the moves
+// after the current ply around, so they can be replayed until a different move is played.
+typedef struct {
+    Move *moves;
+    Undo *undos;                // `undos[i]` takes `moves[i]` back
+    size_t ply;                 // Moves played to reach the current position
+    size_t length;              // Moves recorded, `ply` or more
+    size_t capacity;
+    GameContext *checkpoints;   // `checkpoints[i]` is the position at ply i*HISTORY_CHECKPOINT_INTERVAL
+    size_t checkpoint_count;
+    size_t checkpoint_capacity;
+} GameHistory;
+
+// Starts an empty history from the position in `ctx`
+bool history_init(GameHistory *history, const GameContext *ctx);
+void history_free(GameHistory *history);
+
+// Plays `move` in `ctx` and records it, forgetting the moves that came after the current ply.
+// Returns false, without playing the move, if the history can't grow.
+bool history_push(GameHistory *history, GameContext *ctx, Move move);
+// Takes back the last move played in O(1) and returns it, or returns NO_MOVE at the start of the game
+Move history_pop(GameHistory *history, GameContext *ctx);
+// Sets `ctx` to the position at `ply`, which can be anywhere up to `length`
+void history_jump(GameHistory *history, GameContext *ctx, size_t ply);
+
+#endif // HISTORY_H_
@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "nnue.h"
+
+#define NNUE_MAGIC "PCNN"
+#define NNUE_VERSION 1
+
+// Registers of 16-bit lanes the accumulator is worked on with. Unaligned loads and stores are as fast
+// as aligned ones on anything that has AVX2, and save us from aligning every accumulator.
+#if defined(__AVX2__)
+typedef __m256i Vector;
+#define VECTOR_LANES 16
+#define vector_load(p) _mm256_loadu_si256((const __m256i *) (p))
+#define vector_store(p, v) _mm256_storeu_si256((__m256i *) (p), (v))
+#define vector_add(a, b) _mm256_add_epi16((a), (b))
+#define vector_sub(a, b) _mm256_sub_epi16((a), (b))
+#define vector_clamp(v) _mm256_min_epi16(_mm256_max_epi16((v), _mm256_setzero_si256()), _mm256_set1_epi16(NNUE_ACTIVATION_MAX))
+#define vector_madd(a, b) _mm256_madd_epi16((a), (b))
+#define vector_add32(a, b) _mm256_add_epi32((a), (b))
+#define vector_zero() _mm256_setzero_si256()
+#elif defined(__SSE2__)
+typedef __m128i Vector;
+#define VECTOR_LANES 8
+#define vector_load(p) _mm_loadu_si128((const __m128i *) (p))
+#define vector_store(p, v) _mm_storeu_si128((__m128i *) (p), (v))
+#define vector_add(a, b) _mm_add_epi16((a), (b))
+#define vector_sub(a, b) _mm_sub_epi16((a), (b))
+#define vector_clamp(v) _mm_min_epi16(_mm_max_epi16((v), _mm_setzero_si128()), _mm_set1_epi16(NNUE_ACTIVATION_MAX))
+#define vector_madd(a, b) _mm_madd_epi16((a), (b))
+#define vector_add32(a, b) _mm_add_epi32((a), (b))
+#define vector_zero() _mm_setzero_si128()
+#endif
+
+#ifdef VECTOR_LANES
+static inline int32_t vector_sum32(Vector v)
+{
+#if defined(__AVX2__)
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+#else
+    __m128i sum = v;
+#endif
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+}
+#endif
+
+const char *nnue_simd_name(void)
+{
+#if defined(__AVX2__)
+    return "AVX2";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+bool nnue_alloc(Network *net)
+{
+    memset(net, 0, sizeof(*net));
+    net->feature_weights = malloc((size_t) NNUE_INPUTS*NNUE_HIDDEN*sizeof(int16_t));
+    return net->feature_weights != NULL;
+}
+
+void nnue_free(Network *net)
+{
+    free(net->feature_weights);
+    net->feature_weights = NULL;
+}
+
+// The file is little-endian like the machines we run on, so the arrays are read straight into place
+bool nnue_load(Network *net, const char *path)
+{
+    // Whatever `net` held belongs to the caller: only the buffers allocated here are freed on failure
+    memset(net, 0, sizeof(*net));
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    char magic[4];
+    uint32_t header[4];
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, NNUE_MAGIC, 4) == 0
+           && fread(header, sizeof(uint32_t), 4, file) == 4 && header[0] == NNUE_VERSION
+           && header[1] == NNUE_INPUTS && header[2] == NNUE_HIDDEN && header[3] == NNUE_L1;
+    ok = ok && nnue_alloc(net);
+    ok = ok && fread(net->feature_biases, sizeof(int16_t), NNUE_HIDDEN, file) == NNUE_HIDDEN;
+    ok = ok && fread(net->feature_weights, sizeof(int16_t), (size_t) NNUE_INPUTS*NNUE_HIDDEN, file) == (size_t) NNUE_INPUTS*NNUE_HIDDEN;
+    ok = ok && fread(net->l1_biases, sizeof(int32_t), NNUE_L1, file) == NNUE_L1;
+    ok = ok && fread(net->l1_weights, sizeof(int16_t), NNUE_L1*2*NNUE_HIDDEN, file) == NNUE_L1*2*NNUE_HIDDEN;
+    ok = ok && fread(&net->output_bias, sizeof(int32_t), 1, file) == 1;
+    ok = ok && fread(net->output_weights, sizeof(int16_t), NNUE_L1, file) == NNUE_L1;
+    fclose(file);
+    if (!ok) nnue_free(net);
+    return ok;
+}
+
+static inline size_t feature_index(Player perspective, int king_square, PieceType type, Player player, int square)
+{
+    if (perspective == BL) {
+        king_square ^= 56;
+        square ^= 56;
+    }
+    size_t kind = type*2 + (player != perspective);
+    return ((size_t) king_square*NNUE_PIECE_KINDS + kind)*64 + square;
+}
+
+static inline const int16_t *feature_row(const Network *net, size_t index)
+{
+    return &net->feature_weights[index*NNUE_HIDDEN];
+}
+
+// out = in + the added rows - the removed rows, in one pass over the accumulator
+static void apply_rows(int16_t *out, const int16_t *in, const int16_t **added, int added_count, const int16_t **removed, int removed_count)
+{
+#ifdef VECTOR_LANES
+    for (int i = 0; i < NNUE_HIDDEN; i += VECTOR_LANES) {
+        Vector v = vector_load(&in[i]);
+        for (int j = 0; j < added_count; j++) v = vector_add(v, vector_load(&added[j][i]));
+        for (int j = 0; j < removed_count; j++) v = vector_sub(v, vector_load(&removed[j][i]));
+        vector_store(&out[i], v);
+    }
+#else
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        int16_t v = in[i];
+        for (int j = 0; j < added_count; j++) v += added[j][i];
+        for (int j = 0; j < removed_count; j++) v -= removed[j][i];
+        out[i] = v;
+    }
+#endif
+}
+
+void nnue_refresh(const Network *net, const GameContext *ctx, Player perspective, Accumulator *acc)
+{
+    int king_square = lsb(ctx->pieces[KING] & ctx->players[perspective]);
+    int16_t *values = acc->values[perspective];
+    memcpy(values, net->feature_biases, sizeof(net->feature_biases));
+    for (Player p = WH; p <= BL; p++) {
+        for (PieceType type = PAWN; type < KING; type++) {
+            Bitboard pieces = ctx->pieces[type] & ctx->players[p];
+            while (pieces) {
+                const int16_t *row = feature_row(net, feature_index(perspective, king_square, type, p, pop_lsb(&pieces)));
+                apply_rows(values, values, &row, 1, NULL, 0);
+            }
+        }
+    }
+}
+
+void nnue_refresh_all(const Network *net, const GameContext *ctx, Accumulator *acc)
+{
+    nnue_refresh(net, ctx, WH, acc);
+    nnue_refresh(net, ctx, BL, acc);
+}
+
+static inline void add_dirty(DirtyPieces *dirty, bool added, PieceType type, Player player, int square)
+{
+    if (type == KING) return;
+    if (added) dirty->added[dirty->added_count++] = (DirtyPiece) {type, player, square};
+    else dirty->removed[dirty->removed_count++] = (DirtyPiece) {type, player, square};
+}
+
+void nnue_dirty_pieces(const GameContext *ctx, Move move, DirtyPieces *dirty)
+{
+    int from = move_from(move), to = move_to(move);
+    Square from_sq = square_of(from), to_sq = square_of(to);
+    PieceType type = type_at(ctx, from_sq.row, from_sq.col);
+    PieceType promotion = move_promotion(move);
+    Player us = ctx->turn, them = 1 - ctx->turn;
+
+    dirty->removed_count = 0;
+    dirty->added_count = 0;
+    dirty->mover = us;
+    dirty->king_moved = type == KING;
+    add_dirty(dirty, false, type, us, from);
+    add_dirty(dirty, true, (promotion != EMPTY) ? promotion : type, us, to);
+    switch (move_type(move)) {
+        case CAPTURE:
+            add_dirty(dirty, false, type_at(ctx, to_sq.row, to_sq.col), them, to);
+            break;
+        case EN_PASSANT:
+            add_dirty(dirty, false, PAWN, them, SQUARE_INDEX(from_sq.row, to_sq.col));
+            break;
+        case CASTLES_SHORT:
+            add_dirty(dirty, false, ROOK, us, SQUARE_INDEX(to_sq.row, H));
+            add_dirty(dirty, true, ROOK, us, to - 1);
+            break;
+        case CASTLES_LONG:
+            add_dirty(dirty, false, ROOK, us, SQUARE_INDEX(to_sq.row, A));
+            add_dirty(dirty, true, ROOK, us, to + 1);
+            break;
+        default:
+            break;
+    }
+}
+
+void nnue_update(const Network *net, const GameContext *ctx, const DirtyPieces *dirty, const Accumulator *parent, Accumulator *child)
+{
+    for (Player perspective = WH; perspective <= BL; perspective++) {
+        // Every input of the mover depends on where its king stands
+        if (dirty->king_moved && perspective == dirty->mover) {
+            nnue_refresh(net, ctx, perspective, child);
+            continue;
+        }
+        int king_square = lsb(ctx->pieces[KING] & ctx->players[perspective]);
+        const int16_t *added[2], *removed[2];
+        for (int i = 0; i < dirty->added_count; i++) {
+            added[i] = feature_row(net, feature_index(perspective, king_square, dirty->added[i].type, dirty->added[i].player, dirty->added[i].square));
+        }
+        for (int i = 0; i < dirty->removed_count; i++) {
+            removed[i] = feature_row(net, feature_index(perspective, king_square, dirty->removed[i].type, dirty->removed[i].player, dirty->removed[i].square));
+        }
+        apply_rows(child->values[perspective], parent->values[perspective], added, dirty->added_count, removed, dirty->removed_count);
+    }
+}
+
+int nnue_evaluate(const Network *net, const Accumulator *acc, Player turn)
+{
+    int16_t input[2*NNUE_HIDDEN];
+    const int16_t *sides[2] = {acc->values[turn], acc->values[1 - turn]};
+    int32_t output = net->output_bias;
+
+#ifdef VECTOR_LANES
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < NNUE_HIDDEN; i += VECTOR_LANES) {
+            vector_store(&input[s*NNUE_HIDDEN + i], vector_clamp(vector_load(&sides[s][i])));
+        }
+    }
+    // Four neurons at a time, so that each load of the input serves four of them and the sums don't wait on each other
+    for (int i = 0; i < NNUE_L1; i += 4) {
+        Vector sum0 = vector_zero(), sum1 = vector_zero(), sum2 = vector_zero(), sum3 = vector_zero();
+        for (int j = 0; j < 2*NNUE_HIDDEN; j += VECTOR_LANES) {
+            Vector in = vector_load(&input[j]);
+            sum0 = vector_add32(sum0, vector_madd(in, vector_load(&net->l1_weights[i][j])));
+            sum1 = vector_add32(sum1, vector_madd(in, vector_load(&net->l1_weights[i + 1][j])));
+            sum2 = vector_add32(sum2, vector_madd(in, vector_load(&net->l1_weights[i + 2][j])));
+            sum3 = vector_add32(sum3, vector_madd(in, vector_load(&net->l1_weights[i + 3][j])));
+        }
+        int32_t sums[4] = {vector_sum32(sum0), vector_sum32(sum1), vector_sum32(sum2), vector_sum32(sum3)};
+        for (int k = 0; k < 4; k++) {
+            int32_t l1 = (net->l1_biases[i + k] + sums[k]) >> NNUE_L1_SHIFT;
+            output += (l1 < 0 ? 0 : l1 > NNUE_ACTIVATION_MAX ? NNUE_ACTIVATION_MAX : l1)*net->output_weights[i + k];
+        }
+    }
+#else
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            int16_t v = sides[s][i];
+            input[s*NNUE_HIDDEN + i] = v < 0 ? 0 : v > NNUE_ACTIVATION_MAX ? NNUE_ACTIVATION_MAX : v;
+        }
+    }
+    for (int i = 0; i < NNUE_L1; i++) {
+        int32_t sum = net->l1_biases[i];
+        for (int j = 0; j < 2*NNUE_HIDDEN; j++) sum += input[j]*net->l1_weights[i][j];
+        int32_t l1 = sum >> NNUE_L1_SHIFT;
+        output += (l1 < 0 ? 0 : l1 > NNUE_ACTIVATION_MAX ? NNUE_ACTIVATION_MAX : l1)*net->output_weights[i];
+    }
+#endif
+    return output/NNUE_OUTPUT_SCALE;
+}
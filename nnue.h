@@ -0,0 +1,78 @@
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <stdint.h>
+
+#include "rules.h"
+
+// An efficiently updatable neural network evaluation (NNUE) with HalfKP inputs: for each side, one input per
+// square of its king, times the kind and color of a piece other than a king, times the square of that piece.
+// Seen from black, the board is flipped so that both sides look at it from their own first row.
+#define NNUE_PIECE_KINDS 10
+#define NNUE_INPUTS (64*NNUE_PIECE_KINDS*64)
+#define NNUE_HIDDEN 256
+#define NNUE_L1 32
+// Clipped ReLU bounds the activations to [0, NNUE_ACTIVATION_MAX]
+#define NNUE_ACTIVATION_MAX 127
+#define NNUE_L1_SHIFT 6
+#define NNUE_OUTPUT_SCALE 16
+
+// The first layer summed over the active inputs, for each side. Moves only touch a few inputs, so this is
+// updated from the parent position instead of being summed again, except for the side whose king moved.
+typedef struct {
+    int16_t values[2][NNUE_HIDDEN];
+} Accumulator;
+
+// The evaluation of a position, from the side to move `us`:
+//   input  = clamp(values[us]) followed by clamp(values[them]), 2*NNUE_HIDDEN activations
+//   l1[i]  = clamp((l1_biases[i] + sum_j input[j]*l1_weights[i][j]) >> NNUE_L1_SHIFT)
+//   score  = (output_bias + sum_i l1[i]*output_weights[i])/NNUE_OUTPUT_SCALE centipawns
+typedef struct {
+    int16_t *feature_weights;   // NNUE_INPUTS rows of NNUE_HIDDEN, NULL while no network is loaded
+    int16_t feature_biases[NNUE_HIDDEN];
+    int16_t l1_weights[NNUE_L1][2*NNUE_HIDDEN];
+    int32_t l1_biases[NNUE_L1];
+    int16_t output_weights[NNUE_L1];
+    int32_t output_bias;
+} Network;
+
+typedef struct {
+    PieceType type;
+    Player player;
+    int square;
+} DirtyPiece;
+
+// Pieces that a move takes off and puts on the board, kings aside, since they are not inputs
+typedef struct {
+    DirtyPiece removed[2];
+    DirtyPiece added[2];
+    int removed_count;
+    int added_count;
+    Player mover;
+    bool king_moved;            // The accumulator of the mover must then be refreshed
+} DirtyPieces;
+
+bool nnue_alloc(Network *net);
+void nnue_free(Network *net);
+// Reads a network from a weights file (see README.md for the layout) into `net`, which is overwritten without being
+// freed. On failure `net` is left without one.
+bool nnue_load(Network *net, const char *path);
+static inline bool nnue_loaded(const Network *net)
+{
+    return net != NULL && net->feature_weights != NULL;
+}
+
+// Sums the first layer over every piece of the board, for one side or for both
+void nnue_refresh(const Network *net, const GameContext *ctx, Player perspective, Accumulator *acc);
+void nnue_refresh_all(const Network *net, const GameContext *ctx, Accumulator *acc);
+// What `move` changes on the board, to be called before making it
+void nnue_dirty_pieces(const GameContext *ctx, Move move, DirtyPieces *dirty);
+// Builds the accumulator of the position after a move from the one before it. `ctx` is the position after the move.
+void nnue_update(const Network *net, const GameContext *ctx, const DirtyPieces *dirty, const Accumulator *parent, Accumulator *child);
+// From the point of view of the side to move, in centipawns
+int nnue_evaluate(const Network *net, const Accumulator *acc, Player turn);
+
+// Instruction set the accumulator and the first layer were compiled for
+const char *nnue_simd_name(void);
+
+#endif // NNUE_H_
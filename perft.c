@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rules.h"
+
+typedef struct {
+    const char *name;
+    const char *fen;
+    int depth;
+    uint64_t nodes;
+} PerftPosition;
+
+// Reference node counts from the Chess Programming Wiki and Martin Sedlak's edge case collection
+static const PerftPosition suite[] = {
+    {"Start position",              START_FEN,                                                                  6, 119060324},
+    {"Kiwipete",                    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",    5, 193690690},
+    {"Position 3",                  "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",                               6, 11030083},
+    {"Position 4",                  "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",        5, 15833292},
+    {"Position 5",                  "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",               4, 2103487},
+    {"Position 6",                  "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+    {"Illegal en passant #1",       "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1",                                        6, 1134888},
+    {"Illegal en passant #2",       "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1",                                       6, 1015133},
+    {"En passant gives check",      "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1",                                      6, 1440467},
+    {"Short castling gives check",  "5k2/8/8/8/8/8/8/4K2R w K - 0 1",                                           6, 661072},
+    {"Long castling gives check",   "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1",                                           6, 803711},
+    {"Castling rights",             "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1",                                4, 1274206},
+    {"Castling prevented",          "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1",                                 4, 1720476},
+    {"Promote out of check",        "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1",                                        6, 3821001},
+    {"Discovered check",            "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1",                                      5, 1004658},
+    {"Promote to give check",       "4k3/1P6/8/8/8/8/K7/8 w - - 0 1",                                           6, 217342},
+    {"Underpromote to give check",  "8/P1k5/K7/8/8/8/8/8 w - - 0 1",                                            6, 92683},
+    {"Self stalemate",              "K1k5/8/P7/8/8/8/8/8 w - - 0 1",                                            6, 2217},
+    {"Stalemate and checkmate #1",  "8/k1P5/8/1K6/8/8/8/8 w - - 0 1",                                           7, 567584},
+    {"Stalemate and checkmate #2",  "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1",                                        4, 23527},
+};
+
+void print_speed(uint64_t nodes, double elapsed)
+{
+    printf("Nodes: %llu\n", (unsigned long long) nodes);
+    printf("Time: %.3f s\n", elapsed);
+    printf("NPS: %.0f\n", elapsed > 0 ? nodes/elapsed : 0.0);
+}
+
+// Prints the node count below each root move, which is what we compare against other engines when hunting bugs
+void divide(GameContext *ctx, int depth)
+{
+    MoveList legal_moves;
+    Undo undo;
+    char text[6];
+    uint64_t total = 0;
+
+    double start = clock_seconds();
+    generate_legal_moves(ctx, &legal_moves);
+    for (unsigned int i = 0; i < legal_moves.count; i++) {
+        make_move(ctx, legal_moves.moves[i], &undo);
+        uint64_t nodes = perft(ctx, depth - 1);
+        unmake_move(ctx, legal_moves.moves[i], &undo);
+        move_to_uci(legal_moves.moves[i], text);
+        printf("%s: %llu\n", text, (unsigned long long) nodes);
+        total += nodes;
+    }
+    double elapsed = clock_seconds() - start;
+    printf("\n");
+    print_speed(total, elapsed);
+}
+
+int run_suite(void)
+{
+    size_t count = sizeof(suite)/sizeof(suite[0]);
+    size_t failed = 0;
+    uint64_t total = 0;
+    GameContext ctx;
+
+    double start = clock_seconds();
+    for (size_t i = 0; i < count; i++) {
+        if (!load_fen(&ctx, suite[i].fen)) {
+            printf("%-28s invalid FEN\n", suite[i].name);
+            failed++;
+            continue;
+        }
+        // The suite's FENs are written the way `save_fen` writes them, so they must come back unchanged
+        char fen[FEN_CAP];
+        save_fen(&ctx, fen);
+        bool round_trip = strcmp(fen, suite[i].fen) == 0;
+        double position_start = clock_seconds();
+        uint64_t nodes = perft(&ctx, suite[i].depth);
+        double elapsed = clock_seconds() - position_start;
+        bool ok = nodes == suite[i].nodes && round_trip;
+        if (!ok) failed++;
+        total += nodes;
+        printf("%-28s depth %d %12llu nodes %8.3f s %12.0f nps  %s\n", suite[i].name, suite[i].depth,
+               (unsigned long long) nodes, elapsed, elapsed > 0 ? nodes/elapsed : 0.0, ok ? "ok" : "FAILED");
+        if (nodes != suite[i].nodes) printf("    expected %llu nodes\n", (unsigned long long) suite[i].nodes);
+        if (!round_trip) printf("    saved back as %s\n", fen);
+    }
+    double elapsed = clock_seconds() - start;
+
+    printf("\n%zu/%zu positions passed\n", count - failed, count);
+    print_speed(total, elapsed);
+    return failed == 0 ? 0 : 1;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [--magic] <depth> [fen]\n", program);
+    fprintf(stderr, "       %s [--magic] --suite\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    init_tables();
+    // Magic multiplications even where PEXT is available, to compare the two
+    if (argc > 1 && strcmp(argv[1], "--magic") == 0) {
+        init_slider_tables(false);
+        argc--;
+        argv++;
+    }
+    SliderTables sliders = slider_tables();
+    printf("Slider attacks: %s, %zu KB of tables filled in %.2f ms\n\n", sliders.method, sliders.bytes/1024, sliders.init_seconds*1000);
+
+    if (argc == 2 && strcmp(argv[1], "--suite") == 0) return run_suite();
+    if (argc < 2 || argc > 3) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int depth = atoi(argv[1]);
+    if (depth < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *fen = (argc == 3) ? argv[2] : START_FEN;
+    GameContext ctx;
+    if (!load_fen(&ctx, fen)) {
+        fprintf(stderr, "Invalid FEN: %s\n", fen);
+        return 1;
+    }
+    divide(&ctx, depth);
+    return 0;
+}
@@ -0,0 +1,176 @@
+#include <string.h>
+
+#include "pgn.h"
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static inline bool at_line_start(const char *p, const char *begin)
+{
+    return p == begin || p[-1] == '\n';
+}
+
+static const char *skip_past(const char *p, const char *end, char c)
+{
+    const char *found = memchr(p, c, end - p);
+    return (found != NULL) ? found + 1 : end;
+}
+
+static const char *skip_comment(const char *p, const char *end)
+{
+    if (*p == '{') return skip_past(p, end, '}');
+    return skip_past(p, end, '\n');
+}
+
+static const char *skip_token(const char *p, const char *end)
+{
+    while (p < end && !is_space(*p) && strchr("{}();[", *p) == NULL) p++;
+    return p;
+}
+
+static bool is_result(const char *token, size_t length)
+{
+    return (length == 3 && (memcmp(token, "1-0", 3) == 0 || memcmp(token, "0-1", 3) == 0)) ||
+           (length == 7 && memcmp(token, "1/2-1/2", 7) == 0) ||
+           (length == 1 && *token == '*');
+}
+
+void pgn_reader_init(PgnReader *reader, const char *data, size_t size)
+{
+    reader->cursor = data;
+    reader->end = data + size;
+}
+
+size_t pgn_split(const char *data, size_t size, size_t parts, PgnReader *readers)
+{
+    const char *end = data + size;
+    const char *begin = data;
+    size_t count = 0;
+    for (size_t i = 1; i <= parts; i++) {
+        const char *boundary = end;
+        if (i < parts) {
+            // Every game starts with its Event tag, which can't be found anywhere else
+            const char *p = data + size/parts*i;
+            if (p < begin) p = begin;
+            while ((p = memchr(p, '\n', end - p)) != NULL) {
+                p++;
+                if (end - p >= 7 && memcmp(p, "[Event ", 7) == 0) break;
+            }
+            if (p != NULL) boundary = p;
+        }
+        if (boundary > begin) pgn_reader_init(&readers[count++], begin, boundary - begin);
+        begin = boundary;
+        if (begin == end) break;
+    }
+    return count;
+}
+
+bool pgn_next_game(PgnReader *reader, PgnGame *game)
+{
+    const char *p = reader->cursor, *end = reader->end;
+    while (p < end && is_space(*p)) p++;
+    if (p >= end) {
+        reader->cursor = end;
+        return false;
+    }
+    memset(game, 0, sizeof(*game));
+    game->start = p;
+
+    // Tag pairs, one per line: [Name "Value"]
+    while (p < end && *p == '[') {
+        const char *line_end = memchr(p, '\n', end - p);
+        if (line_end == NULL) line_end = end;
+        if (line_end - p > 5 && memcmp(p, "[FEN ", 5) == 0) {
+            const char *value = memchr(p, '"', line_end - p);
+            const char *value_end = (value != NULL) ? memchr(value + 1, '"', line_end - value - 1) : NULL;
+            if (value_end != NULL) {
+                game->fen = value + 1;
+                game->fen_length = value_end - value - 1;
+            }
+        }
+        p = line_end;
+        while (p < end && is_space(*p)) p++;
+    }
+
+    // The movetext runs until the result, or until the tags of the next game if the result is missing
+    game->movetext = p;
+    while (p < end) {
+        if (is_space(*p)) {
+            p++;
+        } else if (*p == '{' || *p == ';') {
+            p = skip_comment(p, end);
+        } else if (*p == '%' && at_line_start(p, game->movetext)) {
+            p = skip_past(p, end, '\n');
+        } else if (*p == '[' && at_line_start(p, game->movetext)) {
+            break;
+        } else if (strchr("}()[", *p) != NULL) {
+            p++;
+        } else {
+            const char *token_end = skip_token(p, end);
+            if (is_result(p, token_end - p)) {
+                game->result = p;
+                game->movetext_end = p;
+                reader->cursor = token_end;
+                return true;
+            }
+            p = token_end;
+        }
+    }
+    game->movetext_end = p;
+    reader->cursor = p;
+    return true;
+}
+
+bool pgn_start_position(const PgnGame *game, GameContext *ctx)
+{
+    if (game->fen == NULL) {
+        initialize_game(ctx);
+        return true;
+    }
+    char fen[FEN_CAP];
+    if (game->fen_length >= FEN_CAP) return false;
+    memcpy(fen, game->fen, game->fen_length);
+    fen[game->fen_length] = '\0';
+    return load_fen(ctx, fen);
+}
+
+bool pgn_next_san(const char **cursor, const char *end, const char **san)
+{
+    const char *p = *cursor;
+    while (p < end) {
+        if (is_space(*p) || *p == '.') {
+            p++;
+        } else if (*p == '{' || *p == ';') {
+            p = skip_comment(p, end);
+        } else if (*p == '(') {
+            // Variations may nest, and contain comments with parentheses of their own
+            int depth = 0;
+            while (p < end) {
+                if (*p == '{' || *p == ';') {
+                    p = skip_comment(p, end);
+                    continue;
+                }
+                if (*p == '(') depth++;
+                else if (*p == ')' && --depth == 0) {
+                    p++;
+                    break;
+                }
+                p++;
+            }
+        } else if (*p == '$' || (*p >= '1' && *p <= '9')) {
+            // NAGs and move numbers. Moves never start with a digit other than the 0 of 0-0.
+            p++;
+            while (p < end && *p >= '0' && *p <= '9') p++;
+        } else if (strchr("})[]", *p) != NULL) {
+            p++;
+        } else {
+            *san = p;
+            *cursor = skip_token(p, end);
+            return true;
+        }
+    }
+    *cursor = end;
+    return false;
+}
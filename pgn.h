@@ -0,0 +1,30 @@
+#ifndef PGN_H_
+#define PGN_H_
+
+#include "rules.h"
+
+// Walks PGN text in place: nothing is copied or allocated, games and moves point into the input
+typedef struct {
+    const char *cursor;
+    const char *end;
+} PgnReader;
+
+typedef struct {
+    const char *start;          // First byte of the game, for error messages
+    const char *fen;            // Value of the FEN tag, or NULL when the game starts from the usual position
+    size_t fen_length;
+    const char *movetext;
+    const char *movetext_end;
+    const char *result;         // "1-0", "0-1", "1/2-1/2" or "*", NULL if the game isn't terminated
+} PgnGame;
+
+void pgn_reader_init(PgnReader *reader, const char *data, size_t size);
+// Cuts the input into at most `parts` readers that each start at the beginning of a game. Returns how many it made.
+size_t pgn_split(const char *data, size_t size, size_t parts, PgnReader *readers);
+bool pgn_next_game(PgnReader *reader, PgnGame *game);
+bool pgn_start_position(const PgnGame *game, GameContext *ctx);
+// Points `san` at the next move of the movetext and moves `cursor` past it, skipping move numbers, comments,
+// variations and NAGs. Returns false at the end of the movetext. Decode the move with `parse_san`.
+bool pgn_next_san(const char **cursor, const char *end, const char **san);
+
+#endif // PGN_H_
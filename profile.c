@@ -0,0 +1,92 @@
+#include <string.h>
+
+#include "profile.h"
+#include "rules.h"
+
+const char *const profile_section_names[PROFILE_SECTIONS] = {
+    [PROFILE_INPUT] = "input",
+    [PROFILE_MOVEGEN] = "movegen",
+    [PROFILE_STATUS] = "status",
+    [PROFILE_NOTATION] = "notation",
+    [PROFILE_RENDER] = "render",
+    [PROFILE_WAIT] = "wait",
+};
+
+const char *const profile_counter_names[PROFILE_COUNTERS] = {
+    [PROFILE_MOVES_GENERATED] = "moves_generated",
+    [PROFILE_GENERATIONS] = "generations",
+    [PROFILE_TEXT_LAYOUTS] = "text_layouts",
+    [PROFILE_ENGINE_NODES] = "engine_nodes",
+};
+
+void profile_init(Profiler *profiler)
+{
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->start = clock_seconds();
+    profiler->mark = profiler->start;
+    profiler->current = PROFILE_INPUT;
+}
+
+ProfileSection profile_enter(Profiler *profiler, ProfileSection section)
+{
+    double now = clock_seconds();
+    ProfileSection previous = profiler->current;
+    profiler->frames[profiler->frame % PROFILE_HISTORY].seconds[previous] += now - profiler->mark;
+    profiler->mark = now;
+    profiler->current = section;
+    return previous;
+}
+
+static void write_csv_line(Profiler *profiler, const ProfileFrame *frame)
+{
+    fprintf(profiler->csv, "%llu,%.6f,%.4f", (unsigned long long) profiler->frame, profiler->mark - profiler->start,
+            profile_frame_seconds(frame)*1000);
+    for (int i = 0; i < PROFILE_SECTIONS; i++) fprintf(profiler->csv, ",%.4f", frame->seconds[i]*1000);
+    for (int i = 0; i < PROFILE_COUNTERS; i++) fprintf(profiler->csv, ",%llu", (unsigned long long) frame->counters[i]);
+    fputc('\n', profiler->csv);
+}
+
+void profile_next_frame(Profiler *profiler)
+{
+    profile_enter(profiler, PROFILE_INPUT);
+    if (profiler->csv != NULL) write_csv_line(profiler, &profiler->frames[profiler->frame % PROFILE_HISTORY]);
+    profiler->frame++;
+    memset(&profiler->frames[profiler->frame % PROFILE_HISTORY], 0, sizeof(ProfileFrame));
+}
+
+unsigned int profile_frame_count(const Profiler *profiler)
+{
+    // The slot of the frame being measured isn't one of them
+    return (profiler->frame < PROFILE_HISTORY - 1) ? profiler->frame : PROFILE_HISTORY - 1;
+}
+
+const ProfileFrame *profile_frame(const Profiler *profiler, unsigned int age)
+{
+    return &profiler->frames[(profiler->frame - 1 - age) % PROFILE_HISTORY];
+}
+
+double profile_frame_seconds(const ProfileFrame *frame)
+{
+    double seconds = 0;
+    for (int i = 0; i < PROFILE_SECTIONS; i++) seconds += frame->seconds[i];
+    return seconds;
+}
+
+bool profile_start_csv(Profiler *profiler, const char *path)
+{
+    profile_stop_csv(profiler);
+    profiler->csv = fopen(path, "w");
+    if (profiler->csv == NULL) return false;
+    fprintf(profiler->csv, "frame,time_s,frame_ms");
+    for (int i = 0; i < PROFILE_SECTIONS; i++) fprintf(profiler->csv, ",%s_ms", profile_section_names[i]);
+    for (int i = 0; i < PROFILE_COUNTERS; i++) fprintf(profiler->csv, ",%s", profile_counter_names[i]);
+    fputc('\n', profiler->csv);
+    return true;
+}
+
+void profile_stop_csv(Profiler *profiler)
+{
+    if (profiler->csv == NULL) return;
+    fclose(profiler->csv);
+    profiler->csv = NULL;
+}
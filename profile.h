@@ -0,0 +1,68 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Frames kept for the overlay's graph
+#define PROFILE_HISTORY 240
+
+// Where the time of a frame goes. Sections don't nest: entering one pauses the one it was entered from.
+typedef enum {
+    PROFILE_INPUT,
+    PROFILE_MOVEGEN,    // Generating the legal moves and checking a drop against them
+    PROFILE_STATUS,     // Check, mate, stalemate and draws
+    PROFILE_NOTATION,
+    PROFILE_RENDER,
+    PROFILE_WAIT,       // Swapping the buffers, then sleeping until the next frame or input event
+    PROFILE_SECTIONS
+} ProfileSection;
+
+typedef enum {
+    PROFILE_MOVES_GENERATED,
+    PROFILE_GENERATIONS,    // Times the legal moves were generated
+    PROFILE_TEXT_LAYOUTS,   // Texts measured and wrapped, rather than found in the cache
+    PROFILE_ENGINE_NODES,   // Searched by the bot since the previous frame
+    PROFILE_COUNTERS
+} ProfileCounter;
+
+typedef struct {
+    double seconds[PROFILE_SECTIONS];
+    uint64_t counters[PROFILE_COUNTERS];
+} ProfileFrame;
+
+typedef struct {
+    ProfileFrame frames[PROFILE_HISTORY];   // Ring of the last frames, the one being measured at `frame % PROFILE_HISTORY`
+    uint64_t frame;
+    ProfileSection current;
+    double mark;                            // When the current section was entered
+    double start;
+    FILE *csv;                              // If not NULL, every finished frame is written to it
+} Profiler;
+
+extern const char *const profile_section_names[PROFILE_SECTIONS];
+extern const char *const profile_counter_names[PROFILE_COUNTERS];
+
+void profile_init(Profiler *profiler);
+// Finishes the frame being measured and starts the next one, in PROFILE_INPUT
+void profile_next_frame(Profiler *profiler);
+// Charges the time since the last switch to the current section, makes `section` the current one
+// and returns the previous one, to go back to it with another call once done
+ProfileSection profile_enter(Profiler *profiler, ProfileSection section);
+
+static inline void profile_count(Profiler *profiler, ProfileCounter counter, uint64_t count)
+{
+    profiler->frames[profiler->frame % PROFILE_HISTORY].counters[counter] += count;
+}
+
+// How many finished frames are kept, and one of them: `age` 0 is the last one finished
+unsigned int profile_frame_count(const Profiler *profiler);
+const ProfileFrame *profile_frame(const Profiler *profiler, unsigned int age);
+double profile_frame_seconds(const ProfileFrame *frame);
+
+// Writes a header, then a line per frame until stopped
+bool profile_start_csv(Profiler *profiler, const char *path);
+void profile_stop_csv(Profiler *profiler);
+
+#endif // PROFILE_H_
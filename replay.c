@@ -0,0 +1,217 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "file_map.h"
+#include "gamedb.h"
+#include "pgn.h"
+
+#define SAN_CAP 16
+// Errors printed per thread, the rest are only counted
+#define MAX_REPORTED_ERRORS 10
+
+typedef struct {
+    PgnReader pgn;
+    GameDbReader db;
+    const char *data;       // Start of the whole file, to print offsets
+    FILE *output;           // If not NULL, the PGN games are written there in the binary format
+    uint64_t games;
+    uint64_t moves;
+    uint64_t errors;
+    bool write_failed;      // Converting stops at the first game that couldn't be written
+    Move game_moves[GAMEDB_MAX_PLIES];   // The game being converted
+} ReplayJob;
+
+void report_error(ReplayJob *job, const char *game_start, const char *message, const char *text, size_t length)
+{
+    if (job->errors++ >= MAX_REPORTED_ERRORS) return;
+    fprintf(stderr, "Game at byte %zu: %s %.*s\n", (size_t) (game_start - job->data), message, (int) length, text);
+}
+
+GameResult pgn_result(const PgnGame *game)
+{
+    if (game->result == NULL) return RESULT_UNKNOWN;
+    if (strncmp(game->result, "1-0", 3) == 0) return RESULT_WHITE_WINS;
+    if (strncmp(game->result, "0-1", 3) == 0) return RESULT_BLACK_WINS;
+    if (strncmp(game->result, "1/2", 3) == 0) return RESULT_DRAW;
+    return RESULT_UNKNOWN;
+}
+
+// Replays every game of the job's part of the PGN file through the rules, checking each move against the legal ones
+void *replay_pgn_main(void *data)
+{
+    ReplayJob *job = data;
+    PgnGame game;
+    GameContext ctx;
+    Undo undo;
+    while (pgn_next_game(&job->pgn, &game)) {
+        job->games++;
+        if (!pgn_start_position(&game, &ctx)) {
+            report_error(job, game.start, "invalid FEN", game.fen, game.fen_length);
+            continue;
+        }
+        const char *cursor = game.movetext, *san;
+        size_t ply_count = 0;
+        bool valid = true;
+        while (pgn_next_san(&cursor, game.movetext_end, &san)) {
+            // The move may be the very last bytes of the file, so it is copied out before being decoded
+            char text[SAN_CAP];
+            size_t length = cursor - san;
+            if (length >= SAN_CAP) length = SAN_CAP - 1;
+            memcpy(text, san, length);
+            text[length] = '\0';
+
+            Move move;
+            if (!parse_san(&ctx, text, &move)) {
+                report_error(job, game.start, "illegal move", san, length);
+                valid = false;
+                break;
+            }
+            make_move(&ctx, move, &undo);
+            if (job->output != NULL && ply_count < GAMEDB_MAX_PLIES) job->game_moves[ply_count] = move;
+            ply_count++;
+            job->moves++;
+        }
+        if (job->output != NULL && valid && ply_count <= GAMEDB_MAX_PLIES
+            && !gamedb_write_game(job->output, game.fen, game.fen_length, pgn_result(&game), job->game_moves, ply_count)) {
+            job->write_failed = true;
+            break;
+        }
+    }
+    return NULL;
+}
+
+// Replays the games of a binary database: the moves are made as they are stored, nothing is decoded
+void *replay_db_main(void *data)
+{
+    ReplayJob *job = data;
+    GameDbGame game;
+    GameContext ctx;
+    Undo undo;
+    while (gamedb_next_game(&job->db, &game)) {
+        job->games++;
+        if (!gamedb_start_position(&game, &ctx)) {
+            report_error(job, game.start, "invalid FEN", game.fen, game.fen_length);
+            continue;
+        }
+        for (size_t i = 0; i < game.ply_count; i++) {
+            // Enough to catch a corrupt file without paying for move generation
+            if (player_at(&ctx, square_of(move_from(game.moves[i])).row, square_of(move_from(game.moves[i])).col) != ctx.turn) {
+                report_error(job, game.start, "corrupt move", "", 0);
+                break;
+            }
+            make_move(&ctx, game.moves[i], &undo);
+            job->moves++;
+        }
+    }
+    return NULL;
+}
+
+void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s <file.pgn | file.pcdb> [threads]\n", program);
+    fprintf(stderr, "       %s <file.pgn> --convert <file.pcdb>\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    int threads = 1;
+    const char *output_path = NULL;
+    if (argc == 4 && strcmp(argv[2], "--convert") == 0) {
+        output_path = argv[3];
+    } else if (argc == 2 || argc == 3) {
+        threads = (argc > 2) ? atoi(argv[2]) : 1;
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FileMap map;
+    if (!map_file(&map, argv[1])) {
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+    init_tables();
+
+    FILE *output = NULL;
+    if (output_path != NULL) {
+        output = fopen(output_path, "wb");
+        if (output == NULL || !gamedb_write_header(output)) {
+            fprintf(stderr, "Could not write %s\n", output_path);
+            return 1;
+        }
+    }
+
+    PgnReader *pgn_readers = malloc(threads*sizeof(PgnReader));
+    GameDbReader *db_readers = malloc(threads*sizeof(GameDbReader));
+    ReplayJob *jobs = calloc(threads, sizeof(ReplayJob));
+    pthread_t *workers = malloc(threads*sizeof(pthread_t));
+    if (pgn_readers == NULL || db_readers == NULL || jobs == NULL || workers == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    bool database = gamedb_is_database(map.data, map.size);
+    GameDbReader db;
+    size_t parts;
+    if (database) {
+        if (output != NULL || !gamedb_reader_init(&db, map.data, map.size)) {
+            fprintf(stderr, "%s\n", (output != NULL) ? "Only PGN files can be converted" : "Unsupported database version");
+            return 1;
+        }
+        parts = gamedb_split(&db, threads, db_readers);
+    } else {
+        parts = pgn_split(map.data, map.size, threads, pgn_readers);
+    }
+
+    double start = clock_seconds();
+    for (size_t i = 0; i < parts; i++) {
+        if (database) jobs[i].db = db_readers[i];
+        else jobs[i].pgn = pgn_readers[i];
+        jobs[i].data = map.data;
+        jobs[i].output = output;
+        pthread_create(&workers[i], NULL, database ? replay_db_main : replay_pgn_main, &jobs[i]);
+    }
+    uint64_t games = 0, moves = 0, errors = 0;
+    bool write_failed = false;
+    for (size_t i = 0; i < parts; i++) {
+        pthread_join(workers[i], NULL);
+        games += jobs[i].games;
+        moves += jobs[i].moves;
+        errors += jobs[i].errors;
+        write_failed = write_failed || jobs[i].write_failed;
+    }
+    double elapsed = clock_seconds() - start;
+
+    printf("Games: %llu (%llu with errors)\n", (unsigned long long) games, (unsigned long long) errors);
+    printf("Moves: %llu\n", (unsigned long long) moves);
+    printf("Time: %.3f s on %zu threads\n", elapsed, parts);
+    if (elapsed > 0) {
+        printf("Games/s: %.0f\n", games/elapsed);
+        printf("Moves/s: %.0f\n", moves/elapsed);
+        printf("MB/s: %.1f\n", map.size/elapsed/(1024*1024));
+    }
+    if (output != NULL) {
+        long size = ftell(output);
+        // A truncated database would read as a valid one with fewer games, so it is removed
+        if (fclose(output) != 0 || write_failed) {
+            fprintf(stderr, "Could not write %s, removed it\n", output_path);
+            remove(output_path);
+            write_failed = true;
+        } else {
+            printf("Wrote %s: %ld bytes, %.1f%% of the PGN\n", output_path, size, map.size > 0 ? 100.0*size/map.size : 0.0);
+        }
+    }
+
+    free(workers);
+    free(jobs);
+    free(db_readers);
+    free(pgn_readers);
+    unmap_file(&map);
+    return (errors == 0 && !write_failed) ? 0 : 1;
+}
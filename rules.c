@@ -0,0 +1,1305 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_PEXT
+#endif
+
+#include "rules.h"
+
+Player player_at(const GameContext *ctx, Row row, Column col)
+{
+    if (!ON_BOARD(row, col)) return NONE;
+    Bitboard bb = SQUARE_BB(row, col);
+    if (ctx->players[WH] & bb) return WH;
+    if (ctx->players[BL] & bb) return BL;
+    return NONE;
+}
+
+PieceType type_at(const GameContext *ctx, Row row, Column col)
+{
+    if (!ON_BOARD(row, col)) return EMPTY;
+    Bitboard bb = SQUARE_BB(row, col);
+    if (!(occupancy(ctx) & bb)) return EMPTY;
+    for (PieceType type = PAWN; type < EMPTY; type++) {
+        if (ctx->pieces[type] & bb) return type;
+    }
+    return EMPTY;
+}
+
+Piece piece_at(const GameContext *ctx, Row row, Column col)
+{
+    return (Piece) {.type = type_at(ctx, row, col), .player = player_at(ctx, row, col), .row = row, .col = col};
+}
+
+void clear_square(GameContext *ctx, Row row, Column col)
+{
+    PieceType type = type_at(ctx, row, col);
+    if (type == EMPTY) return;
+    Player player = player_at(ctx, row, col);
+    int square = SQUARE_INDEX(row, col);
+    ctx->pieces[type] &= ~SQUARE_BB(row, col);
+    ctx->players[player] &= ~SQUARE_BB(row, col);
+    ctx->key ^= zobrist_pieces[player][type][square];
+    ctx->eval.material_mg -= material_mg[player][type];
+    ctx->eval.material_eg -= material_eg[player][type];
+    ctx->eval.psq_mg -= psq_mg[player][type][square];
+    ctx->eval.psq_eg -= psq_eg[player][type][square];
+    ctx->eval.phase -= phase_weights[type];
+}
+
+void put_piece(GameContext *ctx, Row row, Column col, PieceType type, Player player)
+{
+    clear_square(ctx, row, col);
+    int square = SQUARE_INDEX(row, col);
+    ctx->pieces[type] |= SQUARE_BB(row, col);
+    ctx->players[player] |= SQUARE_BB(row, col);
+    ctx->key ^= zobrist_pieces[player][type][square];
+    ctx->eval.material_mg += material_mg[player][type];
+    ctx->eval.material_eg += material_eg[player][type];
+    ctx->eval.psq_mg += psq_mg[player][type][square];
+    ctx->eval.psq_eg += psq_eg[player][type][square];
+    ctx->eval.phase += phase_weights[type];
+}
+
+Bitboard knight_attacks[64];
+Bitboard king_attacks[64];
+Bitboard pawn_attacks[2][64];
+Bitboard between[64][64];
+Bitboard line[64][64];
+
+uint64_t zobrist_pieces[2][EMPTY][64];
+uint64_t zobrist_castling[16];
+uint64_t zobrist_ep_file[8];
+uint64_t zobrist_black_to_move;
+
+// SplitMix64, seeded with a constant so that keys are the same on every run
+uint64_t next_random(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void init_zobrist_keys(void)
+{
+    uint64_t state = 0x5041505952555321ull;
+    for (Player p = WH; p <= BL; p++) {
+        for (PieceType type = PAWN; type < EMPTY; type++) {
+            for (int square = 0; square < 64; square++) zobrist_pieces[p][type][square] = next_random(&state);
+        }
+    }
+    // Each right gets its own key and a set of rights hashes as the xor of its members
+    uint64_t right_keys[4];
+    for (size_t i = 0; i < 4; i++) right_keys[i] = next_random(&state);
+    for (unsigned int rights = 0; rights < 16; rights++) {
+        zobrist_castling[rights] = 0;
+        for (size_t i = 0; i < 4; i++) {
+            if (rights & (1u << i)) zobrist_castling[rights] ^= right_keys[i];
+        }
+    }
+    for (size_t file = 0; file < 8; file++) zobrist_ep_file[file] = next_random(&state);
+    zobrist_black_to_move = next_random(&state);
+}
+
+// Computes the key from scratch. Moves update it incrementally, this is for setting up positions.
+uint64_t compute_key(const GameContext *ctx)
+{
+    uint64_t key = 0;
+    for (Player p = WH; p <= BL; p++) {
+        for (PieceType type = PAWN; type < EMPTY; type++) {
+            Bitboard pieces = ctx->pieces[type] & ctx->players[p];
+            while (pieces) key ^= zobrist_pieces[p][type][pop_lsb(&pieces)];
+        }
+    }
+    key ^= zobrist_castling[ctx->castling];
+    if (ctx->ep_square != NO_SQUARE) key ^= zobrist_ep_file[ctx->ep_square%8];
+    if (ctx->turn == BL) key ^= zobrist_black_to_move;
+    return key;
+}
+
+int material_mg[2][EMPTY];
+int material_eg[2][EMPTY];
+int psq_mg[2][EMPTY][64];
+int psq_eg[2][EMPTY][64];
+const int phase_weights[EMPTY] = {[KNIGHT] = 1, [BISHOP] = 1, [ROOK] = 2, [QUEEN] = 4};
+
+// Piece values and piece-square tables of Ronald Friederich's PeSTO, tuned on a large set of positions.
+// The tables are seen from white, as printed on a diagram: a8 first and h1 last.
+static const int piece_values_mg[EMPTY] = {[PAWN] = 82, [ROOK] = 477, [BISHOP] = 365, [KNIGHT] = 337, [QUEEN] = 1025};
+static const int piece_values_eg[EMPTY] = {[PAWN] = 94, [ROOK] = 512, [BISHOP] = 297, [KNIGHT] = 281, [QUEEN] = 936};
+
+static const int psq_tables_mg[EMPTY][64] = {
+    [PAWN] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+         98, 134,  61,  95,  68, 126,  34, -11,
+         -6,   7,  26,  31,  65,  56,  25, -20,
+        -14,  13,   6,  21,  23,  12,  17, -23,
+        -27,  -2,  -5,  12,  17,   6,  10, -25,
+        -26,  -4,  -4, -10,   3,   3,  33, -12,
+        -35,  -1, -20, -23, -15,  24,  38, -22,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [ROOK] = {
+         32,  42,  32,  51,  63,   9,  31,  43,
+         27,  32,  58,  62,  80,  67,  26,  44,
+         -5,  19,  26,  36,  17,  45,  61,  16,
+        -24, -11,   7,  26,  24,  35,  -8, -20,
+        -36, -26, -12,  -1,   9,  -7,   6, -23,
+        -45, -25, -16, -17,   3,   0,  -5, -33,
+        -44, -16, -20,  -9,  -1,  11,  -6, -71,
+        -19, -13,   1,  17,  16,   7, -37, -26,
+    },
+    [BISHOP] = {
+        -29,   4, -82, -37, -25, -42,   7,  -8,
+        -26,  16, -18, -13,  30,  59,  18, -47,
+        -16,  37,  43,  40,  35,  50,  37,  -2,
+         -4,   5,  19,  50,  37,  37,   7,  -2,
+         -6,  13,  13,  26,  34,  12,  10,   4,
+          0,  15,  15,  15,  14,  27,  18,  10,
+          4,  15,  16,   0,   7,  21,  33,   1,
+        -33,  -3, -14, -21, -13, -12, -39, -21,
+    },
+    [KNIGHT] = {
+       -167, -89, -34, -49,  61, -97, -15,-107,
+        -73, -41,  72,  36,  23,  62,   7, -17,
+        -47,  60,  37,  65,  84, 129,  73,  44,
+         -9,  17,  19,  53,  37,  69,  18,  22,
+        -13,   4,  16,  13,  28,  19,  21,  -8,
+        -23,  -9,  12,  10,  19,  17,  25, -16,
+        -29, -53, -12,  -3,  -1,  18, -14, -19,
+       -105, -21, -58, -33, -17, -28, -19, -23,
+    },
+    [QUEEN] = {
+        -28,   0,  29,  12,  59,  44,  43,  45,
+        -24, -39,  -5,   1, -16,  57,  28,  54,
+        -13, -17,   7,   8,  29,  56,  47,  57,
+        -27, -27, -16, -16,  -1,  17,  -2,   1,
+         -9, -26,  -9, -10,  -2,  -4,   3,  -3,
+        -14,   2, -11,  -2,  -5,   2,  14,   5,
+        -35,  -8,  11,   2,   8,  15,  -3,   1,
+         -1, -18,  -9,  10, -15, -25, -31, -50,
+    },
+    [KING] = {
+        -65,  23,  16, -15, -56, -34,   2,  13,
+         29,  -1, -20,  -7,  -8,  -4, -38, -29,
+         -9,  24,   2, -16, -20,   6,  22, -22,
+        -17, -20, -12, -27, -30, -25, -14, -36,
+        -49,  -1, -27, -39, -46, -44, -33, -51,
+        -14, -14, -22, -46, -44, -30, -15, -27,
+          1,   7,  -8, -64, -43, -16,   9,   8,
+        -15,  36,  12, -54,   8, -28,  24,  14,
+    },
+};
+
+static const int psq_tables_eg[EMPTY][64] = {
+    [PAWN] = {
+          0,   0,   0,   0,   0,   0,   0,   0,
+        178, 173, 158, 134, 147, 132, 165, 187,
+         94, 100,  85,  67,  56,  53,  82,  84,
+         32,  24,  13,   5,  -2,   4,  17,  17,
+         13,   9,  -3,  -7,  -7,  -8,   3,  -1,
+          4,   7,  -6,   1,   0,  -5,  -1,  -8,
+         13,   8,   8,  10,  13,   0,   2,  -7,
+          0,   0,   0,   0,   0,   0,   0,   0,
+    },
+    [ROOK] = {
+         13,  10,  18,  15,  12,  12,   8,   5,
+         11,  13,  13,  11,  -3,   3,   8,   3,
+          7,   7,   7,   5,   4,  -3,  -5,  -3,
+          4,   3,  13,   1,   2,   1,  -1,   2,
+          3,   5,   8,   4,  -5,  -6,  -8, -11,
+         -4,   0,  -5,  -1,  -7, -12,  -8, -16,
+         -6,  -6,   0,   2,  -9,  -9, -11,  -3,
+         -9,   2,   3,  -1,  -5, -13,   4, -20,
+    },
+    [BISHOP] = {
+        -14, -21, -11,  -8,  -7,  -9, -17, -24,
+         -8,  -4,   7, -12,  -3, -13,  -4, -14,
+          2,  -8,   0,  -1,  -2,   6,   0,   4,
+         -3,   9,  12,   9,  14,  10,   3,   2,
+         -6,   3,  13,  19,   7,  10,  -3,  -9,
+        -12,  -3,   8,  10,  13,   3,  -7, -15,
+        -14, -18,  -7,  -1,   4,  -9, -15, -27,
+        -23,  -9, -23,  -5,  -9, -16,  -5, -17,
+    },
+    [KNIGHT] = {
+        -58, -38, -13, -28, -31, -27, -63, -99,
+        -25,  -8, -25,  -2,  -9, -25, -24, -52,
+        -24, -20,  10,   9,  -1,  -9, -19, -41,
+        -17,   3,  22,  22,  22,  11,   8, -18,
+        -18,  -6,  16,  25,  16,  17,   4, -18,
+        -23,  -3,  -1,  15,  10,  -3, -20, -22,
+        -42, -20, -10,  -5,  -2, -20, -23, -44,
+        -29, -51, -23, -15, -22, -18, -50, -64,
+    },
+    [QUEEN] = {
+         -9,  22,  22,  27,  27,  19,  10,  20,
+        -17,  20,  32,  41,  58,  25,  30,   0,
+        -20,   6,   9,  49,  47,  35,  19,   9,
+          3,  22,  24,  45,  57,  40,  57,  36,
+        -18,  28,  19,  47,  31,  34,  39,  23,
+        -16, -27,  15,   6,   9,  17,  10,   5,
+        -22, -23, -30, -16, -16, -23, -36, -32,
+        -33, -28, -22, -43,  -5, -32, -20, -41,
+    },
+    [KING] = {
+        -74, -35, -18, -18, -11,  15,   4, -17,
+        -12,  17,  14,  17,  17,  38,  23,  11,
+         10,  17,  23,  15,  20,  45,  44,  13,
+         -8,  22,  24,  27,  26,  33,  26,   3,
+        -18,  -4,  21,  24,  27,  23,   9, -11,
+        -19,  -3,  11,  21,  23,  16,   7,  -9,
+        -27, -11,   4,  13,  14,   4,  -5, -17,
+        -53, -34, -21, -11, -28, -14, -24, -43,
+    },
+};
+
+void init_eval_tables(void)
+{
+    for (PieceType type = PAWN; type < EMPTY; type++) {
+        material_mg[WH][type] = piece_values_mg[type];
+        material_mg[BL][type] = -piece_values_mg[type];
+        material_eg[WH][type] = piece_values_eg[type];
+        material_eg[BL][type] = -piece_values_eg[type];
+        for (int square = 0; square < 64; square++) {
+            // Flipping the row of a square turns our a1 = 0 order into the diagram order and mirrors it for black
+            psq_mg[WH][type][square] = psq_tables_mg[type][square ^ 56];
+            psq_eg[WH][type][square] = psq_tables_eg[type][square ^ 56];
+            psq_mg[BL][type][square] = -psq_tables_mg[type][square];
+            psq_eg[BL][type][square] = -psq_tables_eg[type][square];
+        }
+    }
+}
+
+// Computes the terms from scratch, see `compute_key`
+EvalTerms compute_eval(const GameContext *ctx)
+{
+    EvalTerms eval = {0};
+    for (Player p = WH; p <= BL; p++) {
+        for (PieceType type = PAWN; type < EMPTY; type++) {
+            Bitboard pieces = ctx->pieces[type] & ctx->players[p];
+            while (pieces) {
+                int square = pop_lsb(&pieces);
+                eval.material_mg += material_mg[p][type];
+                eval.material_eg += material_eg[p][type];
+                eval.psq_mg += psq_mg[p][type][square];
+                eval.psq_eg += psq_eg[p][type][square];
+                eval.phase += phase_weights[type];
+            }
+        }
+    }
+    return eval;
+}
+
+Bitboard leaper_attacks(int square, const int offsets[][2], size_t count)
+{
+    Bitboard attacks = 0;
+    Row row = square/8 + 1;
+    Column col = square%8 + 1;
+    for (size_t i = 0; i < count; i++) {
+        Row r = row + offsets[i][0];
+        Column c = col + offsets[i][1];
+        if (ON_BOARD(r, c)) attacks |= SQUARE_BB(r, c);
+    }
+    return attacks;
+}
+
+// Squares seen from `square` along one direction, up to and including the first occupied square
+Bitboard ray_attacks(int square, Bitboard occupied, int drow, int dcol)
+{
+    Bitboard attacks = 0;
+    Row r = square/8 + 1 + drow;
+    Column c = square%8 + 1 + dcol;
+    while (ON_BOARD(r, c)) {
+        attacks |= SQUARE_BB(r, c);
+        if (occupied & SQUARE_BB(r, c)) break;
+        r += drow;
+        c += dcol;
+    }
+    return attacks;
+}
+
+// Walking the rays is only done to fill the tables below
+Bitboard bishop_rays(int square, Bitboard occupied)
+{
+    return ray_attacks(square, occupied, 1, 1) | ray_attacks(square, occupied, 1, -1)
+         | ray_attacks(square, occupied, -1, 1) | ray_attacks(square, occupied, -1, -1);
+}
+
+Bitboard rook_rays(int square, Bitboard occupied)
+{
+    return ray_attacks(square, occupied, 1, 0) | ray_attacks(square, occupied, -1, 0)
+         | ray_attacks(square, occupied, 0, 1) | ray_attacks(square, occupied, 0, -1);
+}
+
+// Magic bitboards: the attacks of a slider only depend on the squares of its rays that may block it, the last
+// square of each ray aside. Those bits of the occupancy are packed into an index, either by multiplying them by
+// a magic number that gathers them in the top bits without collisions, or with the PEXT instruction of BMI2.
+typedef struct {
+    Bitboard mask;          // Squares that may block the slider
+    Bitboard magic;
+    Bitboard *attacks;      // One entry for each subset of `mask`
+    unsigned int shift;     // 64 minus the bits of `mask`
+} Magic;
+
+// Sums over the squares of 2 to the number of blocking squares
+#define BISHOP_TABLE_SIZE 5248
+#define ROOK_TABLE_SIZE 102400
+
+static Magic bishop_magics[64];
+static Magic rook_magics[64];
+static Bitboard bishop_table[BISHOP_TABLE_SIZE];
+static Bitboard rook_table[ROOK_TABLE_SIZE];
+static bool slider_pext;
+static double slider_init_seconds;
+
+static inline unsigned int magic_index(const Magic *m, Bitboard occupied)
+{
+    return (unsigned int) (((occupied & m->mask) * m->magic) >> m->shift);
+}
+
+#ifdef HAVE_PEXT
+// Only called once the CPU is known to have BMI2, and inlined when the whole file is built for it
+__attribute__((target("bmi2"))) static inline unsigned int pext_index(const Magic *m, Bitboard occupied)
+{
+    return (unsigned int) _pext_u64(occupied, m->mask);
+}
+#endif
+
+Bitboard bishop_attacks(int square, Bitboard occupied)
+{
+    const Magic *m = &bishop_magics[square];
+#ifdef HAVE_PEXT
+    if (slider_pext) return m->attacks[pext_index(m, occupied)];
+#endif
+    return m->attacks[magic_index(m, occupied)];
+}
+
+Bitboard rook_attacks(int square, Bitboard occupied)
+{
+    const Magic *m = &rook_magics[square];
+#ifdef HAVE_PEXT
+    if (slider_pext) return m->attacks[pext_index(m, occupied)];
+#endif
+    return m->attacks[magic_index(m, occupied)];
+}
+
+// Found once by trying sparse random numbers until one sent every subset of the mask to an entry of its own,
+// or to one holding the same attacks. The index takes as many bits as the mask has squares, no more.
+static const Bitboard bishop_magic_numbers[64] = {
+    0x0028081000404304ull, 0x0004100202043080ull, 0x0610008200584040ull, 0x0044104204400800ull,
+    0x0042021080002082ull, 0x1042020220082A10ull, 0xC600580210120000ull, 0x0020208400A01030ull,
+    0x0008401004013040ull, 0x0000040440840102ull, 0x0100110804910004ull, 0x4090480A0A201000ull,
+    0x000C420210100200ull, 0x2440420864042001ull, 0x0048408808880400ull, 0x00001C4200900800ull,
+    0x0004190AA0580210ull, 0x800200A002240900ull, 0x0429001822040150ull, 0x820C040240108020ull,
+    0x0081000820080800ull, 0x0004100200420800ull, 0x0114400111082080ull, 0x000058010402010Aull,
+    0x18042000C1080100ull, 0x400442C09002280Aull, 0x0800880850084010ull, 0x0110808008020102ull,
+    0x0009020184008408ull, 0x0200820009006201ull, 0x080812000888C400ull, 0x0804029108209400ull,
+    0x6502601000441000ull, 0x8032010431200883ull, 0x2006022200040800ull, 0x0000208400580210ull,
+    0x4A00420020220080ull, 0x0220840100809004ull, 0x0102081240021A10ull, 0x0084140480002080ull,
+    0x202801B8200008C0ull, 0x0285014120001000ull, 0x1000220822003001ull, 0x0080004200811800ull,
+    0x1404080104000044ull, 0x000210420A004020ull, 0x0008880080810400ull, 0x0010240890200084ull,
+    0x0008824110402100ull, 0x800420A804100001ull, 0xC000031409140004ull, 0x2060300820880200ull,
+    0x00100C0450440808ull, 0x2400083010088304ull, 0x0020A02240910000ull, 0x0002A40102020088ull,
+    0x1002008211100300ull, 0x0400202E08044400ull, 0x000005220104A800ull, 0x14208C0004840400ull,
+    0x0000010030121200ull, 0x4000501082900700ull, 0xC4E1080288080100ull, 0x4008100100490A00ull,
+};
+static const Bitboard rook_magic_numbers[64] = {
+    0x0080046481114000ull, 0x2440002002100540ull, 0x0C80200080900108ull, 0x3080100080040800ull,
+    0x8A001002004820A4ull, 0x0300082400010002ull, 0x0200080081040200ull, 0x408009C525000080ull,
+    0x0880800080204010ull, 0x0229808040002000ull, 0x0402808020001000ull, 0x080A002008401200ull,
+    0x1000800400800800ull, 0x4032000802011004ull, 0x8000800100020080ull, 0x0002000080591204ull,
+    0x2050410024800302ull, 0x8010004000200040ull, 0x0201430010200101ull, 0x0000828008001004ull,
+    0x2040808008000402ull, 0x2800818004000600ull, 0x0008840002088110ull, 0x0000820000440081ull,
+    0x1080802080004000ull, 0x0000200540005000ull, 0x0000200280100180ull, 0x1200100080080080ull,
+    0x0009004500300800ull, 0x0080040801402010ull, 0x0826008040400100ull, 0x0404802080004900ull,
+    0x0A40008000802048ull, 0x0000802000804000ull, 0x2440200101004010ull, 0x0000100080800800ull,
+    0x4008000901000510ull, 0x8101001803001400ull, 0x2000880144004210ull, 0x4408208042000104ull,
+    0x0840400020818000ull, 0xC004200050024000ull, 0x8040200010008080ull, 0x1120100008008080ull,
+    0x0308050008010010ull, 0x6015204004080110ull, 0x0000212802840010ull, 0x0000404484060001ull,
+    0xA080402080011900ull, 0x0040008040200380ull, 0x8089A00C41001100ull, 0x8040081001002100ull,
+    0x0010080010050100ull, 0x0328A04004900801ull, 0x1A04800100020080ull, 0x14108D9403014200ull,
+    0x10C50180001A2041ull, 0x0041284001001281ull, 0x021A00209140800Aull, 0x2020200409001001ull,
+    0x02020005A0081002ull, 0x8102000810010402ull, 0x0000102200811804ull, 0x2401000200204081ull,
+};
+
+// Fills the attacks of one square from `table` on, walking every subset of the mask with the carry-rippler
+// trick, and returns the entries used
+static size_t init_magic(Magic *m, Bitboard *table, int square, Bitboard magic, Bitboard (*rays)(int, Bitboard))
+{
+    Bitboard rows = 0xFF000000000000FFull & ~(0xFFull << (square/8*8));
+    Bitboard columns = 0x8181818181818181ull & ~(0x0101010101010101ull << (square%8));
+    m->mask = rays(square, 0) & ~(rows | columns);
+    m->magic = magic;
+    m->shift = 64 - __builtin_popcountll(m->mask);
+    m->attacks = table;
+    Bitboard occupied = 0;
+    do {
+        unsigned int index = magic_index(m, occupied);
+#ifdef HAVE_PEXT
+        if (slider_pext) index = pext_index(m, occupied);
+#endif
+        table[index] = rays(square, occupied);
+        occupied = (occupied - m->mask) & m->mask;
+    } while (occupied);
+    return (size_t) 1 << (64 - m->shift);
+}
+
+void init_slider_tables(bool use_pext)
+{
+    double start = clock_seconds();
+    slider_pext = false;
+#ifdef HAVE_PEXT
+    slider_pext = use_pext && __builtin_cpu_supports("bmi2");
+#else
+    (void) use_pext;
+#endif
+    size_t bishop_used = 0, rook_used = 0;
+    for (int square = 0; square < 64; square++) {
+        bishop_used += init_magic(&bishop_magics[square], &bishop_table[bishop_used], square, bishop_magic_numbers[square], bishop_rays);
+        rook_used += init_magic(&rook_magics[square], &rook_table[rook_used], square, rook_magic_numbers[square], rook_rays);
+    }
+    slider_init_seconds = clock_seconds() - start;
+}
+
+SliderTables slider_tables(void)
+{
+    return (SliderTables) {
+        .method = slider_pext ? "pext" : "magic",
+        .bytes = sizeof(bishop_table) + sizeof(rook_table) + sizeof(bishop_magics) + sizeof(rook_magics),
+        .init_seconds = slider_init_seconds,
+    };
+}
+
+void init_tables(void)
+{
+    init_zobrist_keys();
+    init_eval_tables();
+    init_slider_tables(true);
+    const int knight_offsets[8][2] = {{2, 1}, {2, -1}, {-2, 1}, {-2, -1}, {1, 2}, {1, -2}, {-1, 2}, {-1, -2}};
+    const int king_offsets[8][2] = {{1, -1}, {1, 0}, {1, 1}, {0, -1}, {0, 1}, {-1, -1}, {-1, 0}, {-1, 1}};
+    const int white_pawn_offsets[2][2] = {{1, -1}, {1, 1}};
+    const int black_pawn_offsets[2][2] = {{-1, -1}, {-1, 1}};
+    for (int square = 0; square < 64; square++) {
+        knight_attacks[square] = leaper_attacks(square, knight_offsets, 8);
+        king_attacks[square] = leaper_attacks(square, king_offsets, 8);
+        pawn_attacks[WH][square] = leaper_attacks(square, white_pawn_offsets, 2);
+        pawn_attacks[BL][square] = leaper_attacks(square, black_pawn_offsets, 2);
+    }
+    for (int from = 0; from < 64; from++) {
+        for (size_t i = 0; i < 8; i++) {
+            int drow = king_offsets[i][0];
+            int dcol = king_offsets[i][1];
+            Bitboard full_line = ray_attacks(from, 0, drow, dcol) | ray_attacks(from, 0, -drow, -dcol) | ((Bitboard) 1 << from);
+            Bitboard ray = ray_attacks(from, 0, drow, dcol);
+            while (ray) {
+                int to = pop_lsb(&ray);
+                between[from][to] = ray_attacks(from, (Bitboard) 1 << to, drow, dcol) & ~((Bitboard) 1 << to);
+                line[from][to] = full_line;
+            }
+        }
+    }
+}
+
+// Pieces of both colors that attack `square`, given the `occupied` squares
+Bitboard attackers_to(const GameContext *ctx, int square, Bitboard occupied)
+{
+    return (pawn_attacks[BL][square] & ctx->players[WH] & ctx->pieces[PAWN])
+         | (pawn_attacks[WH][square] & ctx->players[BL] & ctx->pieces[PAWN])
+         | (knight_attacks[square] & ctx->pieces[KNIGHT])
+         | (king_attacks[square] & ctx->pieces[KING])
+         | (bishop_attacks(square, occupied) & (ctx->pieces[BISHOP] | ctx->pieces[QUEEN]))
+         | (rook_attacks(square, occupied) & (ctx->pieces[ROOK] | ctx->pieces[QUEEN]));
+}
+
+// Whether any piece of player `p` attacks `square`. Instead of generating the moves of every
+// enemy piece, we look outward from the square with each piece's movement and see who is there.
+bool attacked_by(const GameContext *ctx, int square, Player p)
+{
+    Bitboard them = ctx->players[p];
+    Bitboard occupied = occupancy(ctx);
+    if (knight_attacks[square] & them & ctx->pieces[KNIGHT]) return true;
+    if (king_attacks[square] & them & ctx->pieces[KING]) return true;
+    // A pawn of `p` attacks `square` from where a pawn of the other player on `square` would attack
+    if (pawn_attacks[1 - p][square] & them & ctx->pieces[PAWN]) return true;
+    if (bishop_attacks(square, occupied) & them & (ctx->pieces[BISHOP] | ctx->pieces[QUEEN])) return true;
+    if (rook_attacks(square, occupied) & them & (ctx->pieces[ROOK] | ctx->pieces[QUEEN])) return true;
+    return false;
+}
+
+// Pass an `occupied` set without the enemy king to see which squares the king may not step back into
+Bitboard compute_attack_map(const GameContext *ctx, Player p, Bitboard occupied)
+{
+    Bitboard pieces = ctx->players[p];
+    Bitboard attacks = 0;
+    while (pieces) {
+        int square = pop_lsb(&pieces);
+        Bitboard bb = (Bitboard) 1 << square;
+        if (ctx->pieces[PAWN] & bb) attacks |= pawn_attacks[p][square];
+        else if (ctx->pieces[KNIGHT] & bb) attacks |= knight_attacks[square];
+        else if (ctx->pieces[KING] & bb) attacks |= king_attacks[square];
+        else {
+            if (ctx->pieces[BISHOP] & bb || ctx->pieces[QUEEN] & bb) attacks |= bishop_attacks(square, occupied);
+            if (ctx->pieces[ROOK] & bb || ctx->pieces[QUEEN] & bb) attacks |= rook_attacks(square, occupied);
+        }
+    }
+    return attacks;
+}
+
+// Piece values of the static exchange evaluation, coarser than the evaluation's so that trades of equal pieces come out even
+const int see_values[EMPTY] = {100, 500, 325, 325, 900, 20000};
+
+// Cheapest first, the order in which an exchange brings the attackers in
+static const PieceType see_order[EMPTY] = {PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING};
+
+// Plays out the captures on the destination of `move`, each side recapturing with its least valuable attacker
+// and free to stop when going on would lose more, then returns what the mover is left with. Sliders behind
+// the pieces that leave are found again by looking from the square through the new occupancy. Pins are ignored.
+int see(const GameContext *ctx, Move move)
+{
+    int from = move_from(move);
+    int to = move_to(move);
+    MoveType type = move_type(move);
+    if (type == CASTLES_SHORT || type == CASTLES_LONG) return 0;
+
+    Square s = square_of(from);
+    Square t = square_of(to);
+    PieceType attacker = type_at(ctx, s.row, s.col);
+    Player side = player_at(ctx, s.row, s.col);
+    PieceType victim = type == EN_PASSANT ? PAWN : type_at(ctx, t.row, t.col);
+    PieceType promotion = move_promotion(move);
+
+    int gain[32];
+    int depth = 0;
+    gain[0] = victim == EMPTY ? 0 : see_values[victim];
+    // What stands on the square after the move, and may be taken next
+    int at_stake = see_values[attacker];
+    if (promotion != EMPTY) {
+        gain[0] += see_values[promotion] - see_values[PAWN];
+        at_stake = see_values[promotion];
+    }
+
+    Bitboard occupied = occupancy(ctx) ^ ((Bitboard) 1 << from);
+    if (type == EN_PASSANT) occupied ^= (Bitboard) 1 << (side == WH ? to - 8 : to + 8);
+    Bitboard diagonal = ctx->pieces[BISHOP] | ctx->pieces[QUEEN];
+    Bitboard straight = ctx->pieces[ROOK] | ctx->pieces[QUEEN];
+    Bitboard attackers = attackers_to(ctx, to, occupied) & occupied;
+
+    while (depth < 31) {
+        side = 1 - side;
+        Bitboard ours = attackers & ctx->players[side];
+        if (!ours) break;
+        PieceType next = EMPTY;
+        Bitboard bb = 0;
+        for (int i = 0; i < EMPTY; i++) {
+            bb = ours & ctx->pieces[see_order[i]];
+            if (bb) {
+                next = see_order[i];
+                break;
+            }
+        }
+        // The king may only take last, when nothing is left to take it back
+        if (next == KING && (attackers & ctx->players[1 - side])) break;
+
+        depth++;
+        gain[depth] = at_stake - gain[depth - 1];
+        // Whether or not the capture is made, the side before is better off: it needn't be played out
+        if (-gain[depth - 1] < 0 && gain[depth] < 0) {
+            depth--;
+            break;
+        }
+
+        occupied ^= bb & -bb;
+        if (next == PAWN || next == BISHOP || next == QUEEN) attackers |= bishop_attacks(to, occupied) & diagonal;
+        if (next == ROOK || next == QUEEN) attackers |= rook_attacks(to, occupied) & straight;
+        attackers &= occupied;
+        at_stake = see_values[next];
+    }
+
+    while (depth > 0) {
+        gain[depth - 1] = -(-gain[depth - 1] > gain[depth] ? -gain[depth - 1] : gain[depth]);
+        depth--;
+    }
+    return gain[0];
+}
+
+// Pieces of `p` the other player wins material by taking: for each one attacked, the best
+// exchange that starts with a capture on its square. Kings are left out, that is check.
+Bitboard hanging_pieces(const GameContext *ctx, Player p)
+{
+    Bitboard hanging = 0;
+    Bitboard occupied = occupancy(ctx);
+    Bitboard targets = ctx->players[p] & ~ctx->pieces[KING];
+    while (targets) {
+        int square = pop_lsb(&targets);
+        Bitboard attackers = attackers_to(ctx, square, occupied) & ctx->players[1 - p];
+        while (attackers) {
+            int from = pop_lsb(&attackers);
+            if (see(ctx, encode_move(from, square, CAPTURE, EMPTY)) > 0) {
+                hanging |= (Bitboard) 1 << square;
+                break;
+            }
+        }
+    }
+    return hanging;
+}
+
+void initialize_board(GameContext *ctx)
+{
+    const PieceType back_rank[8] = {ROOK, KNIGHT, BISHOP, QUEEN, KING, BISHOP, KNIGHT, ROOK};
+    memset(ctx->pieces, 0, sizeof(ctx->pieces));
+    memset(ctx->players, 0, sizeof(ctx->players));
+    ctx->key = 0;
+    memset(&ctx->eval, 0, sizeof(ctx->eval));
+    for (Column col = A; col <= H; col++) {
+        put_piece(ctx, 1, col, back_rank[col - 1], WH);
+        put_piece(ctx, 2, col, PAWN, WH);
+        put_piece(ctx, 7, col, PAWN, BL);
+        put_piece(ctx, 8, col, back_rank[col - 1], BL);
+    }
+}
+
+void initialize_game(GameContext *ctx)
+{
+    initialize_board(ctx);
+    ctx->turn = WH;
+    ctx->check = false;
+    ctx->mate = false;
+    ctx->castling = CASTLE_WH_SHORT | CASTLE_WH_LONG | CASTLE_BL_SHORT | CASTLE_BL_LONG;
+    ctx->ep_square = NO_SQUARE;
+    ctx->halfmove_clock = 0;
+    ctx->fullmove = 1;
+    ctx->key = compute_key(ctx);
+    ctx->key_stack_top = 0;
+    ctx->key_stack[0] = ctx->key;
+    ctx->accept_move = true;
+    ctx->promotion = false;
+    ctx->moves = 0;
+}
+
+// Castling rights that are lost when a piece moves from or to the square
+unsigned int castling_rights_touched(Square sq)
+{
+    switch (SQUARE_INDEX(sq.row, sq.col)) {
+        case SQUARE_INDEX(1, A): return CASTLE_WH_LONG;
+        case SQUARE_INDEX(1, E): return CASTLE_WH_SHORT | CASTLE_WH_LONG;
+        case SQUARE_INDEX(1, H): return CASTLE_WH_SHORT;
+        case SQUARE_INDEX(8, A): return CASTLE_BL_LONG;
+        case SQUARE_INDEX(8, E): return CASTLE_BL_SHORT | CASTLE_BL_LONG;
+        case SQUARE_INDEX(8, H): return CASTLE_BL_SHORT;
+        default: return 0;
+    }
+}
+
+bool load_fen(GameContext *ctx, const char *fen)
+{
+    const char *piece_chars = "prbnqk";
+    initialize_game(ctx);
+    memset(ctx->pieces, 0, sizeof(ctx->pieces));
+    memset(ctx->players, 0, sizeof(ctx->players));
+    memset(&ctx->eval, 0, sizeof(ctx->eval));
+
+    Row row = 8;
+    Column col = A;
+    for (; *fen != ' '; fen++) {
+        if (*fen == '\0') return false;
+        if (*fen == '/') {
+            row--;
+            col = A;
+        } else if (*fen >= '1' && *fen <= '8') {
+            col += *fen - '0';
+        } else {
+            const char *piece_char = strchr(piece_chars, tolower(*fen));
+            if (piece_char == NULL || !ON_BOARD(row, col)) return false;
+            put_piece(ctx, row, col, piece_char - piece_chars, islower(*fen) ? BL : WH);
+            col++;
+        }
+    }
+    if (__builtin_popcountll(ctx->pieces[KING] & ctx->players[WH]) != 1) return false;
+    if (__builtin_popcountll(ctx->pieces[KING] & ctx->players[BL]) != 1) return false;
+
+    fen++;
+    if (*fen != 'w' && *fen != 'b') return false;
+    ctx->turn = (*fen == 'w') ? WH : BL;
+    fen++;
+
+    ctx->castling = 0;
+    while (*fen == ' ') fen++;
+    for (; *fen != ' ' && *fen != '\0'; fen++) {
+        if (*fen == 'K') ctx->castling |= CASTLE_WH_SHORT;
+        else if (*fen == 'Q') ctx->castling |= CASTLE_WH_LONG;
+        else if (*fen == 'k') ctx->castling |= CASTLE_BL_SHORT;
+        else if (*fen == 'q') ctx->castling |= CASTLE_BL_LONG;
+    }
+    // A right is only kept while its king and rook are both at home, as in `make_move`
+    const Square homes[] = {{1, A}, {1, E}, {1, H}, {8, A}, {8, E}, {8, H}};
+    for (size_t i = 0; i < sizeof(homes)/sizeof(homes[0]); i++) {
+        Piece piece = piece_at(ctx, homes[i].row, homes[i].col);
+        PieceType home_type = (homes[i].col == E) ? KING : ROOK;
+        if (piece.type != home_type || piece.player != (homes[i].row == 1 ? WH : BL)) {
+            ctx->castling &= ~castling_rights_touched(homes[i]);
+        }
+    }
+
+    ctx->ep_square = NO_SQUARE;
+    while (*fen == ' ') fen++;
+    if (fen[0] >= 'a' && fen[0] <= 'h' && fen[1] >= '1' && fen[1] <= '8') {
+        int ep_square = SQUARE_INDEX(fen[1] - '0', fen[0] - 'a' + 1);
+        // Same as in `make_move`, the square is dropped when no pawn can take
+        if (pawn_attacks[1 - ctx->turn][ep_square] & ctx->pieces[PAWN] & ctx->players[ctx->turn]) ctx->ep_square = ep_square;
+    }
+    while (*fen != ' ' && *fen != '\0') fen++;
+
+    char *end;
+    unsigned long halfmove_clock = strtoul(fen, &end, 10);
+    if (end != fen) {
+        ctx->halfmove_clock = halfmove_clock;
+        fen = end;
+        unsigned long fullmove = strtoul(fen, &end, 10);
+        if (end != fen && fullmove > 0) ctx->fullmove = fullmove;
+    }
+    ctx->key = compute_key(ctx);
+    ctx->key_stack[0] = ctx->key;
+    ctx->check = is_check(ctx);
+    return true;
+}
+
+void save_fen(const GameContext *ctx, char *fen)
+{
+    const char *piece_chars = "prbnqk";
+    size_t index = 0;
+    for (Row row = 8; row >= 1; row--) {
+        int empty = 0;
+        for (Column col = A; col <= H; col++) {
+            Piece piece = piece_at(ctx, row, col);
+            if (piece.type == EMPTY) {
+                empty++;
+                continue;
+            }
+            if (empty > 0) fen[index++] = '0' + empty;
+            empty = 0;
+            fen[index++] = (piece.player == WH) ? toupper(piece_chars[piece.type]) : piece_chars[piece.type];
+        }
+        if (empty > 0) fen[index++] = '0' + empty;
+        if (row > 1) fen[index++] = '/';
+    }
+
+    fen[index++] = ' ';
+    fen[index++] = (ctx->turn == WH) ? 'w' : 'b';
+    fen[index++] = ' ';
+    if (ctx->castling == 0) fen[index++] = '-';
+    if (ctx->castling & CASTLE_WH_SHORT) fen[index++] = 'K';
+    if (ctx->castling & CASTLE_WH_LONG) fen[index++] = 'Q';
+    if (ctx->castling & CASTLE_BL_SHORT) fen[index++] = 'k';
+    if (ctx->castling & CASTLE_BL_LONG) fen[index++] = 'q';
+
+    // Only written when a capture is possible, since that's all the context remembers
+    fen[index++] = ' ';
+    if (ctx->ep_square == NO_SQUARE) {
+        fen[index++] = '-';
+    } else {
+        fen[index++] = 'a' + ctx->ep_square%8;
+        fen[index++] = '1' + ctx->ep_square/8;
+    }
+    snprintf(&fen[index], FEN_CAP - index, " %u %u", ctx->halfmove_clock, ctx->fullmove);
+}
+
+bool is_in_check(const GameContext *ctx, Player p)
+{
+    return attacked_by(ctx, lsb(ctx->pieces[KING] & ctx->players[p]), 1 - p);
+}
+
+bool is_check(const GameContext *ctx)
+{
+    return is_in_check(ctx, ctx->turn);
+}
+
+void make_move(GameContext *ctx, Move move, Undo *undo)
+{
+    Square from = square_of(move_from(move)), to = square_of(move_to(move));
+    MoveType type = move_type(move);
+    PieceType promotion = move_promotion(move);
+    Piece piece = piece_at(ctx, from.row, from.col);
+    undo->captured = (type == EN_PASSANT) ? PAWN : type_at(ctx, to.row, to.col);
+    undo->key = ctx->key;
+    undo->castling = ctx->castling;
+    undo->ep_square = ctx->ep_square;
+    undo->halfmove_clock = ctx->halfmove_clock;
+    undo->check = ctx->check;
+    undo->mate = ctx->mate;
+
+    clear_square(ctx, from.row, from.col);
+    put_piece(ctx, to.row, to.col, (promotion != EMPTY) ? promotion : piece.type, piece.player);
+    if (type == EN_PASSANT) {
+        clear_square(ctx, from.row, to.col);
+    } else if (type == CASTLES_SHORT) {
+        clear_square(ctx, to.row, H);
+        put_piece(ctx, to.row, to.col - 1, ROOK, piece.player);
+    } else if (type == CASTLES_LONG) {
+        clear_square(ctx, to.row, A);
+        put_piece(ctx, to.row, to.col + 1, ROOK, piece.player);
+    }
+
+    // The pieces were hashed by `clear_square` and `put_piece`, the rest of the state is hashed here
+    ctx->key ^= zobrist_castling[ctx->castling];
+    ctx->castling &= ~(castling_rights_touched(from) | castling_rights_touched(to));
+    ctx->key ^= zobrist_castling[ctx->castling];
+
+    if (ctx->ep_square != NO_SQUARE) ctx->key ^= zobrist_ep_file[ctx->ep_square%8];
+    ctx->ep_square = NO_SQUARE;
+    if (piece.type == PAWN && abs(to.row - from.row) == 2) {
+        // Only remember the square when an enemy pawn could take, so that the same positions hash the same
+        int ep_square = SQUARE_INDEX((from.row + to.row)/2, from.col);
+        if (pawn_attacks[piece.player][ep_square] & ctx->pieces[PAWN] & ctx->players[1 - piece.player]) {
+            ctx->ep_square = ep_square;
+            ctx->key ^= zobrist_ep_file[ep_square%8];
+        }
+    }
+    ctx->key ^= zobrist_black_to_move;
+    ctx->halfmove_clock = (piece.type == PAWN || undo->captured != EMPTY) ? 0 : ctx->halfmove_clock + 1;
+    if (piece.player == BL) ctx->fullmove++;
+    ctx->key_stack_top++;
+    ctx->key_stack[ctx->key_stack_top % KEY_STACK_CAP] = ctx->key;
+    // The caller decides whether it is worth computing these for the new position
+    ctx->check = false;
+    ctx->mate = false;
+    ctx->turn = 1 - ctx->turn;
+}
+
+void unmake_move(GameContext *ctx, Move move, const Undo *undo)
+{
+    Square from = square_of(move_from(move)), to = square_of(move_to(move));
+    MoveType type = move_type(move);
+    PieceType promotion = move_promotion(move);
+    Piece piece = piece_at(ctx, to.row, to.col);
+    clear_square(ctx, to.row, to.col);
+    put_piece(ctx, from.row, from.col, (promotion != EMPTY) ? PAWN : piece.type, piece.player);
+    if (type == EN_PASSANT) {
+        put_piece(ctx, from.row, to.col, PAWN, 1 - piece.player);
+    } else if (undo->captured != EMPTY) {
+        put_piece(ctx, to.row, to.col, undo->captured, 1 - piece.player);
+    } else if (type == CASTLES_SHORT) {
+        clear_square(ctx, to.row, to.col - 1);
+        put_piece(ctx, to.row, H, ROOK, piece.player);
+    } else if (type == CASTLES_LONG) {
+        clear_square(ctx, to.row, to.col + 1);
+        put_piece(ctx, to.row, A, ROOK, piece.player);
+    }
+
+    ctx->key = undo->key;
+    ctx->castling = undo->castling;
+    ctx->ep_square = undo->ep_square;
+    ctx->halfmove_clock = undo->halfmove_clock;
+    ctx->check = undo->check;
+    ctx->mate = undo->mate;
+    ctx->turn = 1 - ctx->turn;
+    if (piece.player == BL) ctx->fullmove--;
+    ctx->key_stack_top--;
+}
+
+static inline void add_move(MoveList *list, int from, int to, MoveType type, PieceType promotion)
+{
+    list->moves[list->count++] = encode_move(from, to, type, promotion);
+}
+
+static inline void add_pawn_moves(MoveList *list, int from, int to, MoveType type)
+{
+    if (to < 8 || to >= 56) {
+        add_move(list, from, to, type, QUEEN);
+        add_move(list, from, to, type, ROOK);
+        add_move(list, from, to, type, BISHOP);
+        add_move(list, from, to, type, KNIGHT);
+    } else {
+        add_move(list, from, to, type, EMPTY);
+    }
+}
+
+static inline void add_moves_to(MoveList *list, int from, Bitboard targets, Bitboard them)
+{
+    while (targets) {
+        int to = pop_lsb(&targets);
+        add_move(list, from, to, (them & ((Bitboard) 1 << to)) ? CAPTURE : MOVE, EMPTY);
+    }
+}
+
+// Generates the legal moves of `kind` of the pieces on `origins`, without playing any of them. Pieces pinned to
+// the king are restricted to the line of the pin, and while in check the other pieces may only
+// land on the `check_mask`: the checking piece or the squares between it and the king.
+static void generate(const GameContext *ctx, MoveList *list, GenKind kind, Bitboard origins)
+{
+    Player p = ctx->turn;
+    Bitboard us = ctx->players[p];
+    Bitboard them = ctx->players[1 - p];
+    Bitboard occupied = us | them;
+    int king = lsb(ctx->pieces[KING] & us);
+    bool king_moves = origins & ((Bitboard) 1 << king);
+    bool captures = kind != GEN_QUIETS;
+    bool quiets = kind != GEN_CAPTURES;
+    Bitboard target_filter = (kind == GEN_CAPTURES) ? them : (kind == GEN_QUIETS) ? ~them : ~(Bitboard) 0;
+    list->count = 0;
+
+    // The king may not step along the line of a slider it is moving away from, so it is removed when computing the danger
+    Bitboard danger = compute_attack_map(ctx, 1 - p, occupied & ~((Bitboard) 1 << king));
+    if (king_moves) add_moves_to(list, king, king_attacks[king] & ~us & ~danger & target_filter, them);
+
+    Bitboard checkers = attackers_to(ctx, king, occupied) & them;
+    if (checkers & (checkers - 1)) return; // Only the king can move out of a double check
+    Bitboard check_mask = checkers ? between[king][lsb(checkers)] | checkers : ~(Bitboard) 0;
+
+    Bitboard pinned = 0;
+    Bitboard snipers = ((rook_attacks(king, them) & (ctx->pieces[ROOK] | ctx->pieces[QUEEN]))
+                     | (bishop_attacks(king, them) & (ctx->pieces[BISHOP] | ctx->pieces[QUEEN]))) & them;
+    while (snipers) {
+        Bitboard blockers = between[king][pop_lsb(&snipers)] & occupied;
+        if (blockers && !(blockers & (blockers - 1)) && (blockers & us)) pinned |= blockers;
+    }
+
+    Bitboard pieces = us & ~ctx->pieces[KING] & ~ctx->pieces[PAWN] & origins;
+    while (pieces) {
+        int from = pop_lsb(&pieces);
+        Bitboard bb = (Bitboard) 1 << from;
+        Bitboard targets;
+        if (ctx->pieces[KNIGHT] & bb) targets = knight_attacks[from];
+        else if (ctx->pieces[BISHOP] & bb) targets = bishop_attacks(from, occupied);
+        else if (ctx->pieces[ROOK] & bb) targets = rook_attacks(from, occupied);
+        else targets = bishop_attacks(from, occupied) | rook_attacks(from, occupied);
+        targets &= ~us & check_mask & target_filter;
+        if (pinned & bb) targets &= line[king][from];
+        add_moves_to(list, from, targets, them);
+    }
+
+    int forward = (p == WH) ? 8 : -8;
+    Bitboard start_rank = (p == WH) ? 0x000000000000FF00ull : 0x00FF000000000000ull;
+    Bitboard last_rank = (p == WH) ? 0xFF00000000000000ull : 0x00000000000000FFull;
+    Bitboard pawns = us & ctx->pieces[PAWN] & origins;
+    while (pawns) {
+        int from = pop_lsb(&pawns);
+        Bitboard bb = (Bitboard) 1 << from;
+        Bitboard allowed = (pinned & bb) ? check_mask & line[king][from] : check_mask;
+
+        Bitboard pawn_captures = captures ? pawn_attacks[p][from] & them & allowed : 0;
+        while (pawn_captures) add_pawn_moves(list, from, pop_lsb(&pawn_captures), CAPTURE);
+
+        int to = from + forward;
+        if (!(occupied & ((Bitboard) 1 << to))) {
+            // Promotions go with the captures, they change the material just as much
+            bool promotes = last_rank & ((Bitboard) 1 << to);
+            if ((allowed & ((Bitboard) 1 << to)) && (promotes ? captures : quiets)) add_pawn_moves(list, from, to, MOVE);
+            int double_to = to + forward;
+            if (quiets && (bb & start_rank) && !(occupied & ((Bitboard) 1 << double_to)) && (allowed & ((Bitboard) 1 << double_to))) {
+                add_move(list, from, double_to, MOVE, EMPTY);
+            }
+        }
+
+        if (captures && ctx->ep_square != NO_SQUARE && (pawn_attacks[p][from] & ((Bitboard) 1 << ctx->ep_square))) {
+            int captured = ctx->ep_square - forward;
+            // Capturing the checking pawn is allowed even though the ep square is not on the check mask
+            if (!(check_mask & (((Bitboard) 1 << ctx->ep_square) | ((Bitboard) 1 << captured)))) continue;
+            // Two pawns leave the row at once, so pins are checked by looking at the king with the resulting occupancy
+            Bitboard after = (occupied & ~bb & ~((Bitboard) 1 << captured)) | ((Bitboard) 1 << ctx->ep_square);
+            if (rook_attacks(king, after) & (ctx->pieces[ROOK] | ctx->pieces[QUEEN]) & them) continue;
+            if (bishop_attacks(king, after) & (ctx->pieces[BISHOP] | ctx->pieces[QUEEN]) & them) continue;
+            add_move(list, from, ctx->ep_square, EN_PASSANT, EMPTY);
+        }
+    }
+
+    if (checkers || !quiets || !king_moves) return;
+    Bitboard back_rank = (p == WH) ? 0x00000000000000FFull : 0xFF00000000000000ull;
+    int rank_start = lsb(back_rank);
+    // A castling right implies that its king and rook are on their initial squares: `load_fen` drops it otherwise
+    if (ctx->castling & CASTLE_SHORT_RIGHT(p)) {
+        Bitboard path = (Bitboard) 0x60 << rank_start;
+        if (!(occupied & path) && !(danger & path)) add_move(list, king, king + 2, CASTLES_SHORT, EMPTY);
+    }
+    if (ctx->castling & CASTLE_LONG_RIGHT(p)) {
+        Bitboard path = (Bitboard) 0x0C << rank_start;
+        if (!(occupied & ((Bitboard) 0x0E << rank_start)) && !(danger & path)) add_move(list, king, king - 2, CASTLES_LONG, EMPTY);
+    }
+}
+
+void generate_legal_moves(const GameContext *ctx, MoveList *list)
+{
+    generate(ctx, list, GEN_ALL, ~(Bitboard) 0);
+}
+
+void generate_moves(const GameContext *ctx, MoveList *list, GenKind kind)
+{
+    generate(ctx, list, kind, ~(Bitboard) 0);
+}
+
+void generate_moves_from(const GameContext *ctx, MoveList *list, int square)
+{
+    generate(ctx, list, GEN_ALL, (Bitboard) 1 << square);
+}
+
+bool is_legal(const GameContext *ctx, Move move)
+{
+    if (move == NO_MOVE || !(ctx->players[ctx->turn] & ((Bitboard) 1 << move_from(move)))) return false;
+    MoveList list;
+    generate_moves_from(ctx, &list, move_from(move));
+    for (unsigned int i = 0; i < list.count; i++) {
+        if (list.moves[i] == move) return true;
+    }
+    return false;
+}
+
+bool is_mate(const GameContext *ctx)
+{
+    MoveList legal_moves;
+    generate_legal_moves(ctx, &legal_moves);
+    return legal_moves.count == 0;
+}
+
+int repetitions(const GameContext *ctx)
+{
+    // Positions before the last irreversible move can't come back, and the closest one that can is 4 plies back
+    unsigned int reach = ctx->halfmove_clock;
+    if (reach > ctx->key_stack_top) reach = ctx->key_stack_top;
+    if (reach > KEY_STACK_CAP - 1) reach = KEY_STACK_CAP - 1;
+    int count = 0;
+    for (unsigned int i = 4; i <= reach; i += 2) {
+        if (ctx->key_stack[(ctx->key_stack_top - i) % KEY_STACK_CAP] == ctx->key) count++;
+    }
+    return count;
+}
+
+bool is_insufficient_material(const GameContext *ctx)
+{
+    const Bitboard dark_squares = 0xAA55AA55AA55AA55;
+    if (ctx->pieces[PAWN] | ctx->pieces[ROOK] | ctx->pieces[QUEEN]) return false;
+    Bitboard minors = ctx->pieces[KNIGHT] | ctx->pieces[BISHOP];
+    if (__builtin_popcountll(minors) <= 1) return true;
+    return ctx->pieces[KNIGHT] == 0 && ((ctx->pieces[BISHOP] & dark_squares) == 0 || (ctx->pieces[BISHOP] & ~dark_squares) == 0);
+}
+
+GameStatus game_status(GameContext *ctx, const MoveList *legal_moves)
+{
+    MoveList generated;
+    if (legal_moves == NULL) {
+        generate_legal_moves(ctx, &generated);
+        legal_moves = &generated;
+    }
+    ctx->check = is_check(ctx);
+    ctx->mate = ctx->check && legal_moves->count == 0;
+    if (ctx->mate) return GAME_CHECKMATE;
+    if (legal_moves->count == 0) return GAME_STALEMATE;
+    if (ctx->halfmove_clock >= 100) return GAME_DRAW_FIFTY_MOVES;
+    if (repetitions(ctx) >= 2) return GAME_DRAW_REPETITION;
+    if (is_insufficient_material(ctx)) return GAME_DRAW_MATERIAL;
+    return GAME_ONGOING;
+}
+
+uint64_t perft(GameContext *ctx, int depth)
+{
+    MoveList legal_moves;
+    Undo undo;
+    uint64_t nodes = 0;
+    if (depth == 0) return 1;
+    generate_legal_moves(ctx, &legal_moves);
+    // Leaves are counted straight from the move list, without playing them
+    if (depth == 1) return legal_moves.count;
+    for (unsigned int i = 0; i < legal_moves.count; i++) {
+        make_move(ctx, legal_moves.moves[i], &undo);
+        nodes += perft(ctx, depth - 1);
+        unmake_move(ctx, legal_moves.moves[i], &undo);
+    }
+    return nodes;
+}
+
+bool is_move_ambiguous(Move move, const GameContext *ctx, const MoveList *legal_moves, bool *needs_file, bool *needs_rank)
+{
+    // Find out if the move is ambiguous, and what tells it apart from the moves of the other pieces
+    Square from = square_of(move_from(move));
+    PieceType type = type_at(ctx, from.row, from.col);
+    MoveList generated;
+    bool ambiguous = false, same_file = false, same_rank = false;
+    if (type != PAWN && type != KING) {
+        if (legal_moves == NULL) {
+            generate_legal_moves(ctx, &generated);
+            legal_moves = &generated;
+        }
+        for (unsigned int i = 0; i < legal_moves->count; i++) {
+            Move other = legal_moves->moves[i];
+            if (move_to(other) != move_to(move) || move_from(other) == move_from(move)) continue;
+            Square other_from = square_of(move_from(other));
+            if (type_at(ctx, other_from.row, other_from.col) != type) continue;
+            ambiguous = true;
+            same_file = same_file || other_from.col == from.col;
+            same_rank = same_rank || other_from.row == from.row;
+        }
+    }
+    // The file is preferred, then the rank, and both are needed when neither is enough on its own
+    *needs_file = ambiguous && (!same_file || same_rank);
+    *needs_rank = ambiguous && same_file;
+    return ambiguous;
+}
+
+void algebraic_notation(Move move, GameContext *ctx, const MoveList *legal_moves, char* notation)
+{
+    size_t index = 0;
+    Square from = square_of(move_from(move)), to = square_of(move_to(move));
+    MoveType type = move_type(move);
+    PieceType promotion = move_promotion(move);
+    Piece piece = piece_at(ctx, from.row, from.col);
+    if (type == CASTLES_SHORT || type == CASTLES_LONG) {
+        index = (type == CASTLES_SHORT) ? 3 : 5;
+        memcpy(notation, "O-O-O", index);
+    } else {
+        bool capture = type == CAPTURE || type == EN_PASSANT;
+        if (piece.type == PAWN && capture) {
+            notation[index++] = 'a' + from.col - 1;
+        } else if (piece.type == KNIGHT) {
+            notation[index++] = 'N';
+        } else if (piece.type == BISHOP) {
+            notation[index++] = 'B';
+        } else if (piece.type == ROOK) {
+            notation[index++] = 'R';
+        } else if (piece.type == KING) {
+            notation[index++] = 'K';
+        } else if (piece.type == QUEEN) {
+            notation[index++] = 'Q';
+        }
+
+        bool needs_file, needs_rank;
+        if (is_move_ambiguous(move, ctx, legal_moves, &needs_file, &needs_rank)) {
+            if (needs_file) notation[index++] = 'a' + piece.col - 1;
+            if (needs_rank) notation[index++] = '1' + piece.row - 1;
+        }
+
+        if (capture) notation[index++] = 'x';
+
+        notation[index++] = 'a' + to.col - 1;
+        notation[index++] = '1' + to.row - 1;
+
+        if (promotion == QUEEN) {
+            notation[index++] = '=';
+            notation[index++] = 'Q';
+        } else if (promotion == ROOK) {
+            notation[index++] = '=';
+            notation[index++] = 'R';
+        } else if (promotion == BISHOP) {
+            notation[index++] = '=';
+            notation[index++] = 'B';
+        } else if (promotion == KNIGHT) {
+            notation[index++] = '=';
+            notation[index++] = 'N';
+        }
+    }
+
+    Undo undo;
+    make_move(ctx, move, &undo);
+    if (is_check(ctx)) {
+        notation[index++] = '+';
+    }
+    unmake_move(ctx, move, &undo);
+
+    notation[index] = '\0';
+}
+
+// Length of the move at the start of `san`, without the check marks and annotations that may follow it
+static size_t san_length(const char *san)
+{
+    size_t length = strspn(san, "abcdefgh12345678NBRQKxO0-=+#!?");
+    while (length > 0 && strchr("+#!?", san[length - 1]) != NULL) length--;
+    return length;
+}
+
+static PieceType san_piece(char c)
+{
+    switch (c) {
+        case 'N': return KNIGHT;
+        case 'B': return BISHOP;
+        case 'R': return ROOK;
+        case 'Q': return QUEEN;
+        case 'K': return KING;
+        default: return EMPTY;
+    }
+}
+
+bool parse_san(GameContext *ctx, const char *san, Move *move)
+{
+    MoveList legal_moves;
+    size_t length = san_length(san);
+    if (length < 2) return false;
+    generate_legal_moves(ctx, &legal_moves);
+
+    // Castling is also written with zeros
+    if (san[0] == 'O' || san[0] == '0') {
+        MoveType type;
+        if (length == 3 && (strncmp(san, "O-O", 3) == 0 || strncmp(san, "0-0", 3) == 0)) type = CASTLES_SHORT;
+        else if (length == 5 && (strncmp(san, "O-O-O", 5) == 0 || strncmp(san, "0-0-0", 5) == 0)) type = CASTLES_LONG;
+        else return false;
+        for (unsigned int i = 0; i < legal_moves.count; i++) {
+            if (move_type(legal_moves.moves[i]) != type) continue;
+            *move = legal_moves.moves[i];
+            return true;
+        }
+        return false;
+    }
+
+    PieceType type = PAWN;
+    size_t begin = 0;
+    if (san_piece(san[0]) != EMPTY) type = san_piece(san[begin++]);
+
+    PieceType promotion = EMPTY;
+    if (type == PAWN && san_piece(san[length - 1]) != EMPTY) {
+        promotion = san_piece(san[--length]);
+        if (length > 0 && san[length - 1] == '=') length--;
+    }
+
+    // What is left: optional origin file and rank, an optional 'x', then the destination
+    if (length < begin + 2) return false;
+    char to_file = san[length - 2], to_rank = san[length - 1];
+    if (to_file < 'a' || to_file > 'h' || to_rank < '1' || to_rank > '8') return false;
+    Column to_col = to_file - 'a' + 1;
+    Row to_row = to_rank - '0';
+    Column from_col = 0;
+    Row from_row = 0;
+    for (size_t i = begin; i < length - 2; i++) {
+        if (san[i] >= 'a' && san[i] <= 'h') from_col = san[i] - 'a' + 1;
+        else if (san[i] >= '1' && san[i] <= '8') from_row = san[i] - '0';
+        else if (san[i] != 'x' && san[i] != '-') return false;
+    }
+
+    bool found = false;
+    for (unsigned int i = 0; i < legal_moves.count; i++) {
+        Move candidate = legal_moves.moves[i];
+        Square from = square_of(move_from(candidate)), to = square_of(move_to(candidate));
+        if (to.col != to_col || to.row != to_row) continue;
+        if (move_promotion(candidate) != promotion) continue;
+        if (from_col != 0 && from.col != from_col) continue;
+        if (from_row != 0 && from.row != from_row) continue;
+        if (type_at(ctx, from.row, from.col) != type) continue;
+        // Not enough to tell two moves apart
+        if (found) return false;
+        *move = candidate;
+        found = true;
+    }
+    return found;
+}
+
+// Long algebraic notation as used by UCI, e.g. "e2e4" or "e7e8q"
+void move_to_uci(Move move, char *text)
+{
+    const char promotion_chars[EMPTY] = {[ROOK] = 'r', [BISHOP] = 'b', [KNIGHT] = 'n', [QUEEN] = 'q'};
+    size_t index = 0;
+    text[index++] = 'a' + move_from(move)%8;
+    text[index++] = '1' + move_from(move)/8;
+    text[index++] = 'a' + move_to(move)%8;
+    text[index++] = '1' + move_to(move)/8;
+    if (move_promotion(move) != EMPTY) text[index++] = promotion_chars[move_promotion(move)];
+    text[index] = '\0';
+}
+
+double clock_seconds(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
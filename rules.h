@@ -0,0 +1,286 @@
+#ifndef RULES_H_
+#define RULES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MOVE_LIST_CAP 256
+#define FEN_CAP 128
+// Enough for the 100 plies of the fifty-move rule, must be a power of two
+#define KEY_STACK_CAP 128
+#define START_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+typedef enum {
+    WH, BL, NONE
+} Player;
+
+typedef enum {
+    PAWN, ROOK, BISHOP, KNIGHT, QUEEN, KING, EMPTY
+} PieceType;
+
+typedef enum {
+    A = 1, B, C, D, E, F, G, H
+} Column;
+
+typedef int Row;
+
+typedef enum {
+    MOVE, CAPTURE, EN_PASSANT, CASTLES_SHORT, CASTLES_LONG
+} MoveType;
+
+typedef struct {
+    Row row;
+    Column col;
+} Square;
+
+// A move packed in 16 bits: the origin square in bits 0-5, the destination in bits 6-11 and the flags in bits 12-15.
+// Flags below 8 are a `MoveType`; from 8 on the move is a promotion, bit 2 telling whether it captures
+// and bits 0-1 the piece (ROOK to QUEEN, minus one). Use the functions below rather than the bits.
+typedef uint16_t Move;
+
+// a1 to a1 can't be a move, so an all zero move means none
+#define NO_MOVE ((Move) 0)
+#define MOVE_PROMOTION_FLAG 8
+#define MOVE_PROMOTION_CAPTURE_FLAG 4
+
+static inline Move encode_move(int from, int to, MoveType type, PieceType promotion)
+{
+    unsigned int flags = type;
+    if (promotion != EMPTY) flags = MOVE_PROMOTION_FLAG | (type == CAPTURE ? MOVE_PROMOTION_CAPTURE_FLAG : 0) | (promotion - ROOK);
+    return (Move) (from | to << 6 | flags << 12);
+}
+
+static inline int move_from(Move move)
+{
+    return move & 63;
+}
+
+static inline int move_to(Move move)
+{
+    return (move >> 6) & 63;
+}
+
+static inline MoveType move_type(Move move)
+{
+    unsigned int flags = move >> 12;
+    if (flags < MOVE_PROMOTION_FLAG) return flags;
+    return (flags & MOVE_PROMOTION_CAPTURE_FLAG) ? CAPTURE : MOVE;
+}
+
+// EMPTY unless a pawn reaches the last row
+static inline PieceType move_promotion(Move move)
+{
+    unsigned int flags = move >> 12;
+    return (flags < MOVE_PROMOTION_FLAG) ? EMPTY : ROOK + (flags & 3);
+}
+
+static inline Square square_of(int index)
+{
+    return (Square) {.row = index/8 + 1, .col = index%8 + 1};
+}
+
+typedef struct {
+    PieceType type;
+    Player player;
+    Row row;
+    Column col;
+} Piece;
+
+// Bit `i` of a bitboard is the square of index `i`, where a1 = 0, b1 = 1, ..., h8 = 63
+typedef uint64_t Bitboard;
+
+#define SQUARE_INDEX(row, col) (((row) - 1)*8 + ((int) (col) - 1))
+#define SQUARE_BB(row, col) ((Bitboard) 1 << SQUARE_INDEX(row, col))
+#define ON_BOARD(row, col) ((row) >= 1 && (row) <= 8 && (int) (col) >= A && (int) (col) <= H)
+#define NO_SQUARE -1
+
+typedef enum {
+    CASTLE_WH_SHORT = 1,
+    CASTLE_WH_LONG = 2,
+    CASTLE_BL_SHORT = 4,
+    CASTLE_BL_LONG = 8,
+} CastlingRight;
+
+// Sums of the piece values and piece-square tables over the board, white's minus black's, each for the middlegame
+// and the endgame. The board keeps them up to date like its key, so that the evaluation only has to blend them.
+typedef struct {
+    int material_mg;
+    int material_eg;
+    int psq_mg;
+    int psq_eg;
+    int phase;              // Weight of the pieces left, pawns and kings aside, from 0 up to PHASE_MAX at the start
+} EvalTerms;
+
+#define PHASE_MAX 24
+
+#define CASTLE_SHORT_RIGHT(player) ((player) == WH ? CASTLE_WH_SHORT : CASTLE_BL_SHORT)
+#define CASTLE_LONG_RIGHT(player) ((player) == WH ? CASTLE_WH_LONG : CASTLE_BL_LONG)
+
+typedef struct {
+    Bitboard pieces[EMPTY]; // Occupancy of each piece type, regardless of color
+    Bitboard players[2];    // Occupancy of each color
+    Player turn;
+    bool check;
+    bool mate;
+    unsigned int castling;  // Set of `CastlingRight`s still available
+    int ep_square;          // Square a pawn may capture en passant into, or NO_SQUARE
+    unsigned int halfmove_clock; // Plies since the last capture or pawn move, for the fifty-move rule
+    unsigned int fullmove;  // Starts at 1 and goes up after every move of black, as in FEN
+    uint64_t key;           // Zobrist hash of the position, kept up to date by every change to the board
+    EvalTerms eval;         // Kept up to date the same way
+    // Keys of the last positions reached, the current one at `key_stack[key_stack_top % KEY_STACK_CAP]`
+    uint64_t key_stack[KEY_STACK_CAP];
+    unsigned int key_stack_top;
+    bool accept_move;
+    bool promotion;
+    size_t moves;
+} GameContext;
+
+// All the legal moves of a position
+typedef struct {
+    Move moves[MOVE_LIST_CAP];
+    unsigned int count;
+} MoveList;
+
+typedef enum {
+    GEN_ALL,
+    GEN_CAPTURES,   // Captures, en passant and promotions
+    GEN_QUIETS,     // Everything else, castling included
+} GenKind;
+
+typedef enum {
+    GAME_ONGOING,
+    GAME_CHECKMATE,
+    GAME_STALEMATE,
+    GAME_DRAW_REPETITION,
+    GAME_DRAW_FIFTY_MOVES,
+    GAME_DRAW_MATERIAL,
+} GameStatus;
+
+// Everything `make_move` destroys and `unmake_move` needs to take the move back
+typedef struct {
+    PieceType captured;
+    uint64_t key;
+    unsigned int castling;
+    int ep_square;
+    unsigned int halfmove_clock;
+    bool check;
+    bool mate;
+} Undo;
+
+static inline int lsb(Bitboard bb)
+{
+    return __builtin_ctzll(bb);
+}
+
+static inline int pop_lsb(Bitboard *bb)
+{
+    int index = lsb(*bb);
+    *bb &= *bb - 1;
+    return index;
+}
+
+static inline Bitboard occupancy(const GameContext *ctx)
+{
+    return ctx->players[WH] | ctx->players[BL];
+}
+
+// Attack sets of the leapers, indexed by the square they stand on
+extern Bitboard knight_attacks[64];
+extern Bitboard king_attacks[64];
+extern Bitboard pawn_attacks[2][64];
+// Squares strictly between two aligned squares, and the whole board-wide line through them
+extern Bitboard between[64][64];
+extern Bitboard line[64][64];
+
+// Random keys xor-ed together into `GameContext.key`
+extern uint64_t zobrist_pieces[2][EMPTY][64];
+extern uint64_t zobrist_castling[16];
+extern uint64_t zobrist_ep_file[8];
+extern uint64_t zobrist_black_to_move;
+
+// What a piece adds to `GameContext.eval` on each square, negative for black
+extern int material_mg[2][EMPTY];
+extern int material_eg[2][EMPTY];
+extern int psq_mg[2][EMPTY][64];
+extern int psq_eg[2][EMPTY][64];
+extern const int phase_weights[EMPTY];
+extern const int see_values[EMPTY];
+
+// How `bishop_attacks` and `rook_attacks` look the attacks up, "pext" or "magic", the bytes
+// their tables take and the time it took to fill them
+typedef struct {
+    const char *method;
+    size_t bytes;
+    double init_seconds;
+} SliderTables;
+
+// Must be called once before any other function of this module
+void init_tables(void);
+// Fills the slider attack tables again, with PEXT if asked for and the CPU has BMI2 (which `init_tables` checks)
+// and with magic multiplications otherwise. Not safe while another thread looks attacks up.
+void init_slider_tables(bool use_pext);
+SliderTables slider_tables(void);
+uint64_t compute_key(const GameContext *ctx);
+EvalTerms compute_eval(const GameContext *ctx);
+
+Player player_at(const GameContext *ctx, Row row, Column col);
+PieceType type_at(const GameContext *ctx, Row row, Column col);
+Piece piece_at(const GameContext *ctx, Row row, Column col);
+void clear_square(GameContext *ctx, Row row, Column col);
+void put_piece(GameContext *ctx, Row row, Column col, PieceType type, Player player);
+
+void initialize_board(GameContext *ctx);
+void initialize_game(GameContext *ctx);
+// Also reads EPD lines, which stop after the en passant field: the move counters then default to 0 and 1
+// Castling rights whose king or rook has left its square are dropped
+bool load_fen(GameContext *ctx, const char *fen);
+// Writes the position as FEN into `fen`, which must hold FEN_CAP characters
+void save_fen(const GameContext *ctx, char *fen);
+
+Bitboard bishop_attacks(int square, Bitboard occupied);
+Bitboard rook_attacks(int square, Bitboard occupied);
+Bitboard attackers_to(const GameContext *ctx, int square, Bitboard occupied);
+bool attacked_by(const GameContext *ctx, int square, Player p);
+Bitboard compute_attack_map(const GameContext *ctx, Player p, Bitboard occupied);
+
+// Static exchange evaluation: the material `move` wins, or loses if negative, once every capture that
+// follows on its destination square is played out. Works for either player, whoever's turn it is.
+int see(const GameContext *ctx, Move move);
+// Pieces of `p` that the other player would win material by capturing
+Bitboard hanging_pieces(const GameContext *ctx, Player p);
+
+bool is_in_check(const GameContext *ctx, Player p);
+bool is_check(const GameContext *ctx);
+bool is_mate(const GameContext *ctx);
+// How many times the position occurred before, looking back only as far as the last capture or pawn move
+int repetitions(const GameContext *ctx);
+// Neither side has the pieces to mate: bare kings, a single minor piece, or bishops all on squares of one color
+bool is_insufficient_material(const GameContext *ctx);
+// Also updates `check` and `mate`. `legal_moves` are those of the position if the caller already has them,
+// NULL to have them generated once for both mate and stalemate.
+GameStatus game_status(GameContext *ctx, const MoveList *legal_moves);
+
+void make_move(GameContext *ctx, Move move, Undo *undo);
+void unmake_move(GameContext *ctx, Move move, const Undo *undo);
+void generate_legal_moves(const GameContext *ctx, MoveList *list);
+// Only part of the legal moves, for a search that may not need the rest
+void generate_moves(const GameContext *ctx, MoveList *list, GenKind kind);
+void generate_moves_from(const GameContext *ctx, MoveList *list, int square);
+// Whether `move` is one of the legal moves, e.g. a move from the transposition table that may belong to another position
+bool is_legal(const GameContext *ctx, Move move);
+uint64_t perft(GameContext *ctx, int depth);
+
+// Both tell the move apart from the other legal moves, which are generated when `legal_moves` is NULL
+bool is_move_ambiguous(Move move, const GameContext *ctx, const MoveList *legal_moves, bool *needs_file, bool *needs_rank);
+void algebraic_notation(Move move, GameContext *ctx, const MoveList *legal_moves, char* notation);
+// Finds the legal move written in SAN at the start of `san`, which needn't be terminated right after it.
+// Check marks and annotations such as "+", "#" or "!?" are ignored. Fails if no legal move, or more than one, fits.
+bool parse_san(GameContext *ctx, const char *san, Move *move);
+void move_to_uci(Move move, char *text);
+
+// Wall clock in seconds, for the tools and the search to measure themselves
+double clock_seconds(void);
+
+#endif // RULES_H_
@@ -0,0 +1,524 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+// How many nodes are searched between two looks at the clock
+#define TIME_CHECK_INTERVAL 2048
+#define REPORT_INTERVAL 0.1
+// History scores stay within this, older successes fading as new ones come in
+#define HISTORY_MAX 16384
+
+// What the threads of one search share, besides the transposition table
+typedef struct {
+    atomic_bool done;               // Set when the main thread is finished, which stops the helpers
+    atomic_uint_least64_t nodes;    // Nodes searched by the helpers so far
+} SharedSearch;
+
+typedef struct {
+    SearchLimits limits;
+    double start;
+    uint64_t nodes;
+    bool stopped;
+    SharedSearch *shared;
+    int thread_id;                  // 0 for the main thread, which is the only one that reports and decides when to stop
+    uint64_t flushed_nodes;         // Part of `nodes` a helper already added to the shared count
+    // Counted here and added to the table once at the end, so threads don't fight over a shared counter
+    uint64_t tt_probes;
+    uint64_t tt_hits;
+    // Triangular table: row `ply` holds the principal variation found from that ply on
+    Move pv[MAX_PLY][MAX_PLY];
+    int pv_length[MAX_PLY];
+    // Principal variation of the last completed iteration, which the next iteration tries first
+    Move prev_pv[MAX_PLY];
+    int prev_pv_length;
+    // What the last completed iteration found, which is what gets reported
+    SearchResult best;
+    double last_report;
+    // One accumulator per ply when evaluating with a network, each built from the one before by the move in between
+    Accumulator *accumulators;
+    // Quiet moves that caused a cutoff at each ply, likely to do it again in the sibling positions
+    Move killers[MAX_PLY][2];
+    // How well each quiet move did, by side and origin and destination square
+    int history[2][64][64];
+    uint64_t cutoffs;
+    uint64_t first_move_cutoffs;
+} SearchState;
+
+typedef enum {
+    STAGE_HASH, STAGE_GEN_CAPTURES, STAGE_CAPTURES, STAGE_KILLERS, STAGE_GEN_QUIETS, STAGE_QUIETS, STAGE_BAD_CAPTURES,
+    STAGE_DONE
+} PickStage;
+
+// Hands out the moves of a node best first, generating each kind only once the previous ones are used up,
+// so that a node cut off by the hash move or a capture never generates nor sorts the quiet moves
+typedef struct {
+    PickStage stage;
+    Move hash_move;
+    Move killers[2];
+    int killer_index;
+    MoveList moves;
+    int scores[MOVE_LIST_CAP];
+    unsigned int next;
+    // Captures that lose material in the exchange, put off until after the quiet moves
+    Move bad_captures[MOVE_LIST_CAP];
+    unsigned int bad_count;
+    unsigned int bad_next;
+    bool captures_only;         // Stops after the good captures, for the quiescence search
+} MovePicker;
+
+void report(SearchState *state)
+{
+    state->best.cutoffs = state->cutoffs;
+    state->best.first_move_cutoffs = state->first_move_cutoffs;
+    state->best.nodes = state->nodes + atomic_load_explicit(&state->shared->nodes, memory_order_relaxed);
+    state->best.elapsed = clock_seconds() - state->start;
+    state->last_report = state->best.elapsed;
+    if (state->limits.report != NULL) state->limits.report(&state->best, state->limits.report_data);
+}
+
+void check_limits(SearchState *state)
+{
+    if (state->thread_id > 0) {
+        atomic_fetch_add_explicit(&state->shared->nodes, state->nodes - state->flushed_nodes, memory_order_relaxed);
+        state->flushed_nodes = state->nodes;
+        if (atomic_load_explicit(&state->shared->done, memory_order_relaxed)) state->stopped = true;
+        return;
+    }
+    double elapsed = clock_seconds() - state->start;
+    if (state->limits.time_limit > 0 && elapsed >= state->limits.time_limit) state->stopped = true;
+    if (state->limits.stop != NULL && atomic_load_explicit(state->limits.stop, memory_order_relaxed)) state->stopped = true;
+    if (elapsed - state->last_report >= REPORT_INTERVAL) report(state);
+}
+
+// Mate scores are stored relative to the position rather than to the root, as the same position can be reached at any ply
+static inline int score_to_tt(int score, int ply)
+{
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static inline int score_from_tt(int score, int ply)
+{
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+static inline int evaluate_position(const GameContext *ctx, const SearchState *state, int ply)
+{
+    if (state->accumulators != NULL) return nnue_evaluate(state->limits.nnue, &state->accumulators[ply], ctx->turn);
+    return evaluate(ctx);
+}
+
+static inline void search_make_move(GameContext *ctx, SearchState *state, int ply, Move move, Undo *undo)
+{
+    if (state->accumulators == NULL) {
+        make_move(ctx, move, undo);
+        return;
+    }
+    DirtyPieces dirty;
+    nnue_dirty_pieces(ctx, move, &dirty);
+    make_move(ctx, move, undo);
+    nnue_update(state->limits.nnue, ctx, &dirty, &state->accumulators[ply], &state->accumulators[ply + 1]);
+}
+
+static const int mvv_lva_values[EMPTY] = {[PAWN] = 1, [KNIGHT] = 3, [BISHOP] = 3, [ROOK] = 5, [QUEEN] = 9, [KING] = 0};
+
+static inline bool is_quiet(Move move)
+{
+    return move_type(move) != CAPTURE && move_type(move) != EN_PASSANT && move_promotion(move) == EMPTY;
+}
+
+void picker_init(MovePicker *picker, const GameContext *ctx, const SearchState *state, int ply, Move hash_move, bool captures_only)
+{
+    picker->stage = STAGE_HASH;
+    picker->captures_only = captures_only;
+    picker->bad_count = 0;
+    picker->bad_next = 0;
+    // A move from the table may come from another position sharing the index, so it is checked before use
+    picker->hash_move = is_legal(ctx, hash_move) ? hash_move : NO_MOVE;
+    picker->killers[0] = state->killers[ply][0];
+    picker->killers[1] = state->killers[ply][1];
+    picker->killer_index = 0;
+}
+
+// Most valuable victim first, and among captures of the same victim the least valuable attacker first
+static void score_captures(MovePicker *picker, const GameContext *ctx)
+{
+    for (unsigned int i = 0; i < picker->moves.count; i++) {
+        Move move = picker->moves.moves[i];
+        Square from = square_of(move_from(move)), to = square_of(move_to(move));
+        PieceType victim = (move_type(move) == EN_PASSANT) ? PAWN : type_at(ctx, to.row, to.col);
+        PieceType attacker = type_at(ctx, from.row, from.col);
+        int score = (victim != EMPTY) ? 16*mvv_lva_values[victim] - mvv_lva_values[attacker] : 0;
+        if (move_promotion(move) != EMPTY) score += 16*mvv_lva_values[move_promotion(move)];
+        picker->scores[i] = score;
+    }
+}
+
+static void score_quiets(MovePicker *picker, const GameContext *ctx, const SearchState *state)
+{
+    for (unsigned int i = 0; i < picker->moves.count; i++) {
+        Move move = picker->moves.moves[i];
+        picker->scores[i] = state->history[ctx->turn][move_from(move)][move_to(move)];
+    }
+}
+
+// Selection sort one step at a time: most nodes only ever look at the first few moves
+static Move pick_best(MovePicker *picker)
+{
+    unsigned int best = picker->next;
+    for (unsigned int i = picker->next + 1; i < picker->moves.count; i++) {
+        if (picker->scores[i] > picker->scores[best]) best = i;
+    }
+    Move move = picker->moves.moves[best];
+    int score = picker->scores[best];
+    picker->moves.moves[best] = picker->moves.moves[picker->next];
+    picker->scores[best] = picker->scores[picker->next];
+    picker->moves.moves[picker->next] = move;
+    picker->scores[picker->next] = score;
+    picker->next++;
+    return move;
+}
+
+// Returns NO_MOVE once every legal move was handed out
+Move picker_next(MovePicker *picker, const GameContext *ctx, const SearchState *state)
+{
+    switch (picker->stage) {
+        case STAGE_HASH:
+            picker->stage = STAGE_GEN_CAPTURES;
+            if (picker->hash_move != NO_MOVE) return picker->hash_move;
+            // fallthrough
+        case STAGE_GEN_CAPTURES:
+            generate_moves(ctx, &picker->moves, GEN_CAPTURES);
+            score_captures(picker, ctx);
+            picker->next = 0;
+            picker->stage = STAGE_CAPTURES;
+            // fallthrough
+        case STAGE_CAPTURES:
+            while (picker->next < picker->moves.count) {
+                Move move = pick_best(picker);
+                if (move == picker->hash_move) continue;
+                if (see(ctx, move) < 0) {
+                    picker->bad_captures[picker->bad_count++] = move;
+                    continue;
+                }
+                return move;
+            }
+            if (picker->captures_only) {
+                picker->stage = STAGE_DONE;
+                break;
+            }
+            picker->stage = STAGE_KILLERS;
+            // fallthrough
+        case STAGE_KILLERS:
+            while (picker->killer_index < 2) {
+                Move move = picker->killers[picker->killer_index++];
+                if (move != NO_MOVE && move != picker->hash_move && is_legal(ctx, move)) return move;
+            }
+            picker->stage = STAGE_GEN_QUIETS;
+            // fallthrough
+        case STAGE_GEN_QUIETS:
+            generate_moves(ctx, &picker->moves, GEN_QUIETS);
+            score_quiets(picker, ctx, state);
+            picker->next = 0;
+            picker->stage = STAGE_QUIETS;
+            // fallthrough
+        case STAGE_QUIETS:
+            while (picker->next < picker->moves.count) {
+                Move move = pick_best(picker);
+                if (move != picker->hash_move && move != picker->killers[0] && move != picker->killers[1]) return move;
+            }
+            picker->stage = STAGE_BAD_CAPTURES;
+            // fallthrough
+        case STAGE_BAD_CAPTURES:
+            if (picker->bad_next < picker->bad_count) return picker->bad_captures[picker->bad_next++];
+            picker->stage = STAGE_DONE;
+            // fallthrough
+        case STAGE_DONE:
+            break;
+    }
+    return NO_MOVE;
+}
+
+// Moves the score towards `bonus`, the more slowly the closer it is to HISTORY_MAX
+static inline void update_history(int *score, int bonus)
+{
+    *score += bonus - *score*abs(bonus)/HISTORY_MAX;
+}
+
+// A quiet move refuted the position: remember it as a killer and reward it, and punish the quiets tried before it
+static void record_cutoff(SearchState *state, const GameContext *ctx, int ply, int depth, Move move, const Move *tried, int tried_count)
+{
+    if (state->killers[ply][0] != move) {
+        state->killers[ply][1] = state->killers[ply][0];
+        state->killers[ply][0] = move;
+    }
+    int bonus = (depth*depth < HISTORY_MAX) ? depth*depth : HISTORY_MAX;
+    update_history(&state->history[ctx->turn][move_from(move)][move_to(move)], bonus);
+    for (int i = 0; i < tried_count; i++) update_history(&state->history[ctx->turn][move_from(tried[i])][move_to(tried[i])], -bonus);
+}
+
+// Searches only the captures and promotions until the position is quiet, so that the evaluation is never taken
+// in the middle of an exchange. The side to move may stand pat on the evaluation instead of capturing, unless it
+// is in check, where every evasion is searched and having none is mate. Captures losing material are not tried.
+int quiescence(GameContext *ctx, SearchState *state, int ply, int alpha, int beta)
+{
+    state->pv_length[ply] = 0;
+    if (state->nodes % TIME_CHECK_INTERVAL == 0) check_limits(state);
+    if (state->stopped) return 0;
+    state->nodes++;
+
+    if (ply >= MAX_PLY - 1) return evaluate_position(ctx, state, ply);
+    bool in_check = is_check(ctx);
+    if (!in_check) {
+        int stand_pat = evaluate_position(ctx, state, ply);
+        if (stand_pat >= beta) return beta;
+        if (stand_pat > alpha) alpha = stand_pat;
+    }
+
+    MovePicker picker;
+    picker_init(&picker, ctx, state, ply, NO_MOVE, !in_check);
+    int searched = 0;
+    Undo undo;
+    Move move;
+    while ((move = picker_next(&picker, ctx, state)) != NO_MOVE) {
+        search_make_move(ctx, state, ply, move, &undo);
+        int score = -quiescence(ctx, state, ply + 1, -beta, -alpha);
+        unmake_move(ctx, move, &undo);
+        if (state->stopped) return 0;
+        searched++;
+
+        if (score > alpha) {
+            alpha = score;
+            if (alpha >= beta) break;
+        }
+    }
+    if (in_check && searched == 0) return -MATE_SCORE + ply;
+    return alpha;
+}
+
+// Fills the principal variation at `ply` by following the best moves of exact entries from `first` on,
+// as far as they stay legal and don't repeat a position
+void pv_from_tt(GameContext *ctx, SearchState *state, int ply, Move first)
+{
+    Move moves[MAX_PLY];
+    Undo undos[MAX_PLY];
+    int length = 0;
+    Move move = first;
+    while (ply + length < MAX_PLY - 1 && move != NO_MOVE && is_legal(ctx, move)) {
+        moves[length] = move;
+        make_move(ctx, move, &undos[length]);
+        length++;
+        TTData entry;
+        if (repetitions(ctx) > 0 || !tt_probe(state->limits.tt, ctx->key, &entry) || entry.bound != BOUND_EXACT) break;
+        move = entry.move;
+    }
+    memcpy(state->pv[ply], moves, length*sizeof(Move));
+    state->pv_length[ply] = length;
+    while (length > 0) {
+        length--;
+        unmake_move(ctx, moves[length], &undos[length]);
+    }
+}
+
+int negamax(GameContext *ctx, SearchState *state, int depth, int ply, int alpha, int beta, bool follow_pv)
+{
+    state->pv_length[ply] = 0;
+    if (state->nodes % TIME_CHECK_INTERVAL == 0) check_limits(state);
+    if (state->stopped) return 0;
+    state->nodes++;
+
+    // Repeating a position once is enough to call it a draw, whoever could avoid it would have done so
+    if (ply > 0 && (ctx->halfmove_clock >= 100 || repetitions(ctx) > 0 || is_insufficient_material(ctx))) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate_position(ctx, state, ply);
+    if (depth == 0) {
+        // The quiescence search counts this node itself
+        state->nodes--;
+        return quiescence(ctx, state, ply, alpha, beta);
+    }
+
+    TranspositionTable *tt = state->limits.tt;
+    TTData entry;
+    bool tt_hit = false;
+    if (tt != NULL) {
+        state->tt_probes++;
+        tt_hit = tt_probe(tt, ctx->key, &entry);
+        if (tt_hit) {
+            state->tt_hits++;
+            // The root always searches, so that there is a move and a principal variation to report
+            int score = score_from_tt(entry.score, ply);
+            if (ply > 0 && entry.depth >= depth) {
+                if (entry.bound == BOUND_EXACT) {
+                    // The parent builds its variation from this node's, which the table has to stand in for
+                    if (score > alpha && score < beta) pv_from_tt(ctx, state, ply, entry.move);
+                    return score <= alpha ? alpha : score >= beta ? beta : score;
+                }
+                if (entry.bound == BOUND_LOWER && score >= beta) return beta;
+                if (entry.bound == BOUND_UPPER && score <= alpha) return alpha;
+            }
+        }
+    }
+
+    // While we are on the previous principal variation, its move is searched first, otherwise the one the table remembers
+    follow_pv = follow_pv && ply < state->prev_pv_length;
+    Move hash_move = follow_pv ? state->prev_pv[ply] : tt_hit ? entry.move : NO_MOVE;
+    MovePicker picker;
+    picker_init(&picker, ctx, state, ply, hash_move, false);
+
+    int original_alpha = alpha;
+    Move best_move = NO_MOVE;
+    Move quiets_tried[MOVE_LIST_CAP];
+    int quiet_count = 0;
+    int searched = 0;
+    Undo undo;
+    Move move;
+    while ((move = picker_next(&picker, ctx, state)) != NO_MOVE) {
+        search_make_move(ctx, state, ply, move, &undo);
+        int score = -negamax(ctx, state, depth - 1, ply + 1, -beta, -alpha, follow_pv && move == state->prev_pv[ply]);
+        unmake_move(ctx, move, &undo);
+        if (state->stopped) return 0;
+        searched++;
+
+        if (score > alpha) {
+            alpha = score;
+            best_move = move;
+            state->pv[ply][0] = move;
+            memcpy(&state->pv[ply][1], state->pv[ply + 1], state->pv_length[ply + 1]*sizeof(Move));
+            state->pv_length[ply] = state->pv_length[ply + 1] + 1;
+            if (alpha >= beta) {
+                state->cutoffs++;
+                if (searched == 1) state->first_move_cutoffs++;
+                if (is_quiet(move)) record_cutoff(state, ctx, ply, depth, move, quiets_tried, quiet_count);
+                break;
+            }
+        }
+        if (is_quiet(move)) quiets_tried[quiet_count++] = move;
+    }
+    if (searched == 0) return is_check(ctx) ? -MATE_SCORE + ply : 0;
+
+    if (tt != NULL) {
+        TTData store = {
+            .move = best_move,
+            .score = score_to_tt(alpha, ply),
+            .depth = depth,
+            .bound = (alpha >= beta) ? BOUND_LOWER : (alpha > original_alpha) ? BOUND_EXACT : BOUND_UPPER,
+        };
+        tt_store(tt, ctx->key, &store);
+    }
+    return alpha;
+}
+
+void init_state(SearchState *state, SearchLimits limits, SharedSearch *shared, int thread_id)
+{
+    memset(state, 0, sizeof(*state));
+    state->limits = limits;
+    state->start = clock_seconds();
+    state->shared = shared;
+    state->thread_id = thread_id;
+    // Without room for the accumulators, the search falls back on the classical evaluation
+    if (nnue_loaded(limits.nnue)) state->accumulators = malloc(MAX_PLY*sizeof(Accumulator));
+}
+
+void free_state(SearchState *state)
+{
+    free(state->accumulators);
+    state->accumulators = NULL;
+}
+
+// Iterative deepening from `first_depth` on, until the limits run out
+void iterate(GameContext *ctx, SearchState *state, int first_depth)
+{
+    SearchResult *best = &state->best;
+    int max_depth = (state->limits.depth > 0 && state->limits.depth < MAX_PLY) ? state->limits.depth : MAX_PLY - 1;
+    if (state->accumulators != NULL) nnue_refresh_all(state->limits.nnue, ctx, &state->accumulators[0]);
+    for (int depth = first_depth; depth <= max_depth; depth++) {
+        int score = negamax(ctx, state, depth, 0, -INFINITE_SCORE, INFINITE_SCORE, true);
+        // An interrupted iteration is thrown away, as its moves were not all searched
+        if (state->stopped || state->pv_length[0] == 0) break;
+
+        best->best_move = state->pv[0][0];
+        best->score = score;
+        best->depth = depth;
+        best->pv_length = state->pv_length[0];
+        memcpy(best->pv, state->pv[0], state->pv_length[0]*sizeof(Move));
+        memcpy(state->prev_pv, state->pv[0], state->pv_length[0]*sizeof(Move));
+        state->prev_pv_length = state->pv_length[0];
+        if (state->thread_id == 0) report(state);
+
+        // A forced mate won't get any better by looking deeper
+        if (!state->limits.infinite && (score >= MATE_BOUND || score <= -MATE_BOUND)) break;
+    }
+
+    if (state->limits.tt != NULL) {
+        atomic_fetch_add_explicit(&state->limits.tt->probes, state->tt_probes, memory_order_relaxed);
+        atomic_fetch_add_explicit(&state->limits.tt->hits, state->tt_hits, memory_order_relaxed);
+    }
+}
+
+typedef struct {
+    pthread_t thread;
+    GameContext ctx;
+    SearchState state;
+} Helper;
+
+void *helper_main(void *data)
+{
+    Helper *helper = data;
+    // Half of the helpers start one ply deeper than the main thread, so that the threads are spread over
+    // different iterations and fill the table with entries the others can use, instead of all doing the same work
+    iterate(&helper->ctx, &helper->state, 1 + helper->state.thread_id%2);
+    atomic_fetch_add_explicit(&helper->state.shared->nodes, helper->state.nodes - helper->state.flushed_nodes, memory_order_relaxed);
+    free_state(&helper->state);
+    return NULL;
+}
+
+Move search(GameContext *ctx, SearchLimits limits, SearchResult *result)
+{
+    SharedSearch shared;
+    SearchState state;
+    SearchResult *best = &state.best;
+    MoveList root_moves;
+
+    atomic_init(&shared.done, false);
+    atomic_init(&shared.nodes, 0);
+    init_state(&state, limits, &shared, 0);
+    if (limits.tt != NULL) tt_new_search(limits.tt);
+
+    generate_legal_moves(ctx, &root_moves);
+    if (root_moves.count > 0) {
+        best->best_move = root_moves.moves[0];
+
+        // Lazy SMP: the helpers search the same root on their own, and only help through the transposition table
+        int helper_count = (limits.threads > 1) ? ((limits.threads < MAX_THREADS) ? limits.threads : MAX_THREADS) - 1 : 0;
+        Helper *helpers = (helper_count > 0) ? malloc(helper_count*sizeof(Helper)) : NULL;
+        if (helpers == NULL) helper_count = 0;
+        SearchLimits helper_limits = {.tt = limits.tt, .nnue = limits.nnue};
+        for (int i = 0; i < helper_count; i++) {
+            helpers[i].ctx = *ctx;
+            init_state(&helpers[i].state, helper_limits, &shared, i + 1);
+            if (pthread_create(&helpers[i].thread, NULL, helper_main, &helpers[i]) != 0) {
+                free_state(&helpers[i].state);
+                helper_count = i;
+                break;
+            }
+        }
+
+        iterate(ctx, &state, 1);
+
+        atomic_store(&shared.done, true);
+        for (int i = 0; i < helper_count; i++) pthread_join(helpers[i].thread, NULL);
+        free(helpers);
+    }
+    best->nodes = state.nodes + atomic_load(&shared.nodes);
+    best->elapsed = clock_seconds() - state.start;
+    best->cutoffs = state.cutoffs;
+    best->first_move_cutoffs = state.first_move_cutoffs;
+    free_state(&state);
+
+    if (result != NULL) *result = *best;
+    return best->best_move;
+}
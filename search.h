@@ -0,0 +1,52 @@
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <stdatomic.h>
+
+#include "eval.h"
+#include "nnue.h"
+#include "rules.h"
+#include "tt.h"
+
+#define MAX_PLY 64
+#define INFINITE_SCORE 32000
+#define MATE_SCORE 30000
+// Scores above this are mates, the distance to mate in plies being MATE_SCORE - score
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)
+#define MAX_THREADS 256
+
+typedef struct {
+    Move best_move;
+    int score;          // From the point of view of the side to move, in centipawns
+    int depth;          // Last iteration that was completed
+    uint64_t nodes;     // Summed over all the threads
+    double elapsed;
+    Move pv[MAX_PLY];
+    int pv_length;
+    // Beta cutoffs of the main thread, and how many of them came from the first move searched:
+    // the closer the two, the better the moves are ordered
+    uint64_t cutoffs;
+    uint64_t first_move_cutoffs;
+} SearchResult;
+
+typedef struct {
+    int depth;          // Deepest iteration to run, 0 for no limit
+    double time_limit;  // Seconds the search may take, 0 for no limit
+    bool infinite;      // Keeps deepening after finding a forced mate, for analysis that only ends when stopped
+    atomic_bool *stop;  // If not NULL, the search stops as soon as it sees it set, e.g. from another thread
+    TranspositionTable *tt; // If not NULL, positions already searched are looked up in it and remembered there
+    // Threads searching the position together, 0 or 1 for a single one. The helpers only talk to each other
+    // through `tt`, so without a table they are wasted.
+    int threads;
+    // If a network is loaded, positions are evaluated with it instead of the classical evaluation
+    const Network *nnue;
+    // If not NULL, called with the progress after every iteration and a few times per second in between
+    void (*report)(const SearchResult *progress, void *data);
+    void *report_data;
+} SearchLimits;
+
+// Searches the position with iterative deepening and returns the best move found when the limits run out.
+// `ctx` is walked in place and left as it was. `result`, if not NULL, receives the details of the search.
+Move search(GameContext *ctx, SearchLimits limits, SearchResult *result);
+
+#endif // SEARCH_H_
@@ -0,0 +1,186 @@
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "tt.h"
+
+#define HUGE_PAGE_SIZE (2*1024*1024)
+#define CACHE_LINE_SIZE 64
+#define GENERATION_MASK 63
+#define HASHFULL_SAMPLE 1000
+
+// Layout of the data word:
+//   bits  0-15  move             bits 32-39  depth
+//   bits 16-31  score            bits 40-41  bound
+//                                bits 42-47  generation
+static uint64_t pack(const TTData *data, unsigned int generation)
+{
+    uint64_t word = data->move;
+    word |= (uint64_t) (uint16_t) (int16_t) data->score << 16;
+    word |= (uint64_t) (uint8_t) (data->depth < 0 ? 0 : data->depth > 255 ? 255 : data->depth) << 32;
+    word |= (uint64_t) data->bound << 40;
+    word |= (uint64_t) (generation & GENERATION_MASK) << 42;
+    return word;
+}
+
+static void unpack(uint64_t word, TTData *data)
+{
+    data->move = (Move) word;
+    data->score = (int16_t) (uint16_t) (word >> 16);
+    data->depth = (word >> 32) & 255;
+    data->bound = (word >> 40) & 3;
+}
+
+static inline unsigned int generation_of(uint64_t word)
+{
+    return (word >> 42) & GENERATION_MASK;
+}
+
+// High 64 bits of the 128-bit product, from four 32-bit products where the compiler has no 128-bit integers (MSVC, 32-bit targets)
+static inline uint64_t mul_high64(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    return (uint64_t) (((unsigned __int128) a*b) >> 64);
+#else
+    uint64_t a_low = (uint32_t) a, a_high = a >> 32;
+    uint64_t b_low = (uint32_t) b, b_high = b >> 32;
+    uint64_t low_low = a_low*b_low, low_high = a_low*b_high, high_low = a_high*b_low;
+    uint64_t middle = (low_low >> 32) + (uint32_t) low_high + (uint32_t) high_low;
+    return a_high*b_high + (low_high >> 32) + (high_low >> 32) + (middle >> 32);
+#endif
+}
+
+static inline TTBucket *bucket_for(const TranspositionTable *tt, uint64_t key)
+{
+    // Maps the key onto [0, bucket_count) with a multiplication, so the size doesn't need to be a power of two
+    return &tt->buckets[(size_t) mul_high64(key, tt->bucket_count)];
+}
+
+static void *allocate(size_t size, bool huge_pages)
+{
+#ifdef _WIN32
+    (void) huge_pages;
+    return _aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+    size_t alignment = huge_pages ? HUGE_PAGE_SIZE : CACHE_LINE_SIZE;
+    size = (size + alignment - 1)/alignment*alignment;
+    void *memory = aligned_alloc(alignment, size);
+#ifdef __linux__
+    // Transparent huge pages: fewer TLB misses on a table that is accessed at random
+    if (memory != NULL && huge_pages) madvise(memory, size, MADV_HUGEPAGE);
+#endif
+    return memory;
+#endif
+}
+
+void tt_free(TranspositionTable *tt)
+{
+#ifdef _WIN32
+    _aligned_free(tt->buckets);
+#else
+    free(tt->buckets);
+#endif
+    tt->buckets = NULL;
+    tt->bucket_count = 0;
+}
+
+bool tt_init(TranspositionTable *tt, size_t size_mb, bool huge_pages)
+{
+    if (tt->buckets != NULL) tt_free(tt);
+    size_t bucket_count = size_mb*1024*1024/sizeof(TTBucket);
+    if (bucket_count == 0) bucket_count = 1;
+    tt->buckets = allocate(bucket_count*sizeof(TTBucket), huge_pages);
+    if (tt->buckets == NULL) return false;
+    tt->bucket_count = bucket_count;
+#ifdef __linux__
+    tt->huge_pages = huge_pages;
+#else
+    tt->huge_pages = false;
+#endif
+    tt_clear(tt);
+    return true;
+}
+
+void tt_clear(TranspositionTable *tt)
+{
+    // Also makes the kernel actually hand out the pages, so that the first search doesn't pay for it
+    memset(tt->buckets, 0, tt->bucket_count*sizeof(TTBucket));
+    tt->generation = 0;
+    atomic_store(&tt->probes, 0);
+    atomic_store(&tt->hits, 0);
+}
+
+void tt_new_search(TranspositionTable *tt)
+{
+    tt->generation = (tt->generation + 1) & GENERATION_MASK;
+}
+
+bool tt_probe(const TranspositionTable *tt, uint64_t key, TTData *data)
+{
+    TTBucket *bucket = bucket_for(tt, key);
+    for (size_t i = 0; i < TT_BUCKET_SIZE; i++) {
+        uint64_t word = atomic_load_explicit(&bucket->entries[i].data, memory_order_relaxed);
+        uint64_t key_xor_data = atomic_load_explicit(&bucket->entries[i].key_xor_data, memory_order_relaxed);
+        if ((key_xor_data ^ word) != key || ((word >> 40) & 3) == BOUND_NONE) continue;
+        unpack(word, data);
+        return true;
+    }
+    return false;
+}
+
+void tt_store(TranspositionTable *tt, uint64_t key, const TTData *data)
+{
+    TTBucket *bucket = bucket_for(tt, key);
+    TTEntry *replace = NULL;
+    uint64_t old_word = 0;
+    int worst = 0;
+    for (size_t i = 0; i < TT_BUCKET_SIZE; i++) {
+        TTEntry *entry = &bucket->entries[i];
+        uint64_t word = atomic_load_explicit(&entry->data, memory_order_relaxed);
+        uint64_t key_xor_data = atomic_load_explicit(&entry->key_xor_data, memory_order_relaxed);
+        if ((key_xor_data ^ word) == key) {
+            replace = entry;
+            old_word = word;
+            break;
+        }
+        // Prefer replacing empty entries, then entries of older searches, then shallow ones
+        int age = (tt->generation - generation_of(word)) & GENERATION_MASK;
+        int priority = (((word >> 40) & 3) == BOUND_NONE) ? -1000 : (int) ((word >> 32) & 255) - 8*age;
+        if (replace == NULL || priority < worst) {
+            replace = entry;
+            worst = priority;
+        }
+    }
+
+    TTData stored = *data;
+    if (stored.move == NO_MOVE) {
+        // Keep the best move we already knew about, it is still the best guess to search first
+        stored.move = (Move) old_word;
+    }
+    uint64_t word = pack(&stored, tt->generation);
+    atomic_store_explicit(&replace->data, word, memory_order_relaxed);
+    atomic_store_explicit(&replace->key_xor_data, key ^ word, memory_order_relaxed);
+}
+
+void tt_stats(const TranspositionTable *tt, TTStats *stats)
+{
+    size_t sample = tt->bucket_count < HASHFULL_SAMPLE ? tt->bucket_count : HASHFULL_SAMPLE;
+    size_t used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        for (size_t j = 0; j < TT_BUCKET_SIZE; j++) {
+            uint64_t word = atomic_load_explicit(&tt->buckets[i].entries[j].data, memory_order_relaxed);
+            if (((word >> 40) & 3) != BOUND_NONE && generation_of(word) == tt->generation) used++;
+        }
+    }
+    stats->size_mb = tt->bucket_count*sizeof(TTBucket)/(1024*1024);
+    stats->entries = tt->bucket_count*TT_BUCKET_SIZE;
+    stats->hashfull = sample > 0 ? (int) (used*1000/(sample*TT_BUCKET_SIZE)) : 0;
+    stats->probes = atomic_load(&tt->probes);
+    stats->hits = atomic_load(&tt->hits);
+    stats->huge_pages = tt->huge_pages;
+}
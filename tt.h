@@ -0,0 +1,63 @@
+#ifndef TT_H_
+#define TT_H_
+
+#include <stdatomic.h>
+
+#include "rules.h"
+
+typedef enum {
+    BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT
+} Bound;
+
+// What a probe gives back, unpacked from the 64 bits an entry stores
+typedef struct {
+    Move move;          // Best move found in the position, or NO_MOVE
+    int score;
+    int depth;
+    Bound bound;
+} TTData;
+
+// 16 bytes: the data word, and the key xor-ed with it. Entries are written and read without locks,
+// a torn write from another thread just makes the two words disagree and the probe misses.
+typedef struct {
+    atomic_uint_least64_t key_xor_data;
+    atomic_uint_least64_t data;
+} TTEntry;
+
+#define TT_BUCKET_SIZE 4
+
+// One cache line of entries that share an index
+typedef struct {
+    TTEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+typedef struct {
+    TTBucket *buckets;
+    size_t bucket_count;
+    bool huge_pages;        // Whether the kernel was asked to back the table with huge pages
+    unsigned int generation;
+    atomic_uint_least64_t probes;
+    atomic_uint_least64_t hits;
+} TranspositionTable;
+
+typedef struct {
+    size_t size_mb;
+    size_t entries;
+    int hashfull;           // Permille of used entries, sampled from the start of the table
+    uint64_t probes;
+    uint64_t hits;
+    bool huge_pages;
+} TTStats;
+
+// Allocates `size_mb` megabytes, replacing any previous table. Returns false if the allocation fails.
+bool tt_init(TranspositionTable *tt, size_t size_mb, bool huge_pages);
+void tt_free(TranspositionTable *tt);
+void tt_clear(TranspositionTable *tt);
+// Called once per search, so that entries from older searches get replaced first
+void tt_new_search(TranspositionTable *tt);
+
+bool tt_probe(const TranspositionTable *tt, uint64_t key, TTData *data);
+void tt_store(TranspositionTable *tt, uint64_t key, const TTData *data);
+void tt_stats(const TranspositionTable *tt, TTStats *stats);
+
+#endif // TT_H_
@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uci.h"
+#include "engine.h"
+
+#define LINE_CAP 16384
+// Time kept in reserve for the GUI to receive the move, in seconds
+#define MOVE_OVERHEAD 0.05
+// Moves the remaining time is spread over when the GUI doesn't say how many are left
+#define DEFAULT_MOVES_TO_GO 30
+
+typedef struct {
+    TranspositionTable *tt;
+    int last_depth;     // Depth of the last "info" line, so that one line is printed per iteration
+    // "go infinite" must not answer before "stop", even if the search ends on its own: its best move waits here
+    pthread_mutex_t lock;
+    bool hold;
+    bool held;
+    Move held_move;
+} UciState;
+
+void print_info(const SearchResult *progress, void *data)
+{
+    UciState *uci = data;
+    if (progress->depth == 0 || progress->depth == uci->last_depth) return;
+    uci->last_depth = progress->depth;
+
+    char score[32];
+    if (progress->score >= MATE_BOUND) snprintf(score, sizeof(score), "mate %d", (MATE_SCORE - progress->score + 1)/2);
+    else if (progress->score <= -MATE_BOUND) snprintf(score, sizeof(score), "mate -%d", (MATE_SCORE + progress->score)/2);
+    else snprintf(score, sizeof(score), "cp %d", progress->score);
+
+    TTStats stats;
+    tt_stats(uci->tt, &stats);
+    // Written with a single call, since this runs on the worker while the main thread answers the GUI
+    char line[128 + MAX_PLY*6];
+    int length = snprintf(line, sizeof(line), "info depth %d score %s nodes %llu nps %.0f time %.0f hashfull %d pv",
+                          progress->depth, score, (unsigned long long) progress->nodes,
+                          progress->elapsed > 0 ? progress->nodes/progress->elapsed : 0.0, progress->elapsed*1000, stats.hashfull);
+    for (int i = 0; i < progress->pv_length && length < (int) sizeof(line) - 8; i++) {
+        char text[6];
+        move_to_uci(progress->pv[i], text);
+        length += snprintf(&line[length], sizeof(line) - length, " %s", text);
+    }
+    printf("%s\n", line);
+    fflush(stdout);
+}
+
+void write_best_move(Move move)
+{
+    if (move == NO_MOVE) {
+        // No legal moves, the GUI should not have asked
+        printf("bestmove 0000\n");
+    } else {
+        char text[6];
+        move_to_uci(move, text);
+        printf("bestmove %s\n", text);
+    }
+    fflush(stdout);
+}
+
+void print_best_move(const SearchResult *result, void *data)
+{
+    UciState *uci = data;
+    pthread_mutex_lock(&uci->lock);
+    if (uci->hold) {
+        uci->held = true;
+        uci->held_move = result->best_move;
+    } else {
+        write_best_move(result->best_move);
+    }
+    pthread_mutex_unlock(&uci->lock);
+}
+
+// Lets the best move of an infinite search out, now or as soon as the search ends
+void release_best_move(UciState *uci)
+{
+    pthread_mutex_lock(&uci->lock);
+    uci->hold = false;
+    if (uci->held) write_best_move(uci->held_move);
+    uci->held = false;
+    pthread_mutex_unlock(&uci->lock);
+}
+
+bool parse_move(GameContext *ctx, const char *text, Move *move)
+{
+    MoveList legal_moves;
+    generate_legal_moves(ctx, &legal_moves);
+    for (unsigned int i = 0; i < legal_moves.count; i++) {
+        char candidate[6];
+        move_to_uci(legal_moves.moves[i], candidate);
+        if (strcmp(candidate, text) == 0) {
+            *move = legal_moves.moves[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+void parse_position(GameContext *ctx, char *args)
+{
+    char fen[FEN_CAP] = START_FEN;
+    char *token = strtok(args, " \t");
+    if (token != NULL && strcmp(token, "fen") == 0) {
+        fen[0] = '\0';
+        while ((token = strtok(NULL, " \t")) != NULL && strcmp(token, "moves") != 0) {
+            if (fen[0] != '\0') strncat(fen, " ", sizeof(fen) - strlen(fen) - 1);
+            strncat(fen, token, sizeof(fen) - strlen(fen) - 1);
+        }
+    } else {
+        token = strtok(NULL, " \t");
+    }
+    if (!load_fen(ctx, fen)) {
+        printf("info string invalid fen %s\n", fen);
+        load_fen(ctx, START_FEN);
+        return;
+    }
+    if (token == NULL || strcmp(token, "moves") != 0) return;
+
+    Undo undo;
+    while ((token = strtok(NULL, " \t")) != NULL) {
+        Move move;
+        if (!parse_move(ctx, token, &move)) {
+            printf("info string illegal move %s\n", token);
+            return;
+        }
+        make_move(ctx, move, &undo);
+        ctx->moves++;
+    }
+}
+
+// go [wtime <ms>] [btime <ms>] [winc <ms>] [binc <ms>] [movestogo <n>] [movetime <ms>] [depth <n>] [infinite]
+SearchLimits parse_go(const GameContext *ctx, char *args)
+{
+    SearchLimits limits = {0};
+    double time[2] = {0}, increment[2] = {0};
+    int moves_to_go = 0;
+    double move_time = 0;
+    for (char *token = strtok(args, " \t"); token != NULL; token = strtok(NULL, " \t")) {
+        char *value = NULL;
+        if (strcmp(token, "infinite") != 0 && strcmp(token, "ponder") != 0) value = strtok(NULL, " \t");
+        if (strcmp(token, "infinite") == 0) limits.infinite = true;
+        if (value == NULL) continue;
+        if (strcmp(token, "wtime") == 0) time[WH] = atof(value)/1000;
+        else if (strcmp(token, "btime") == 0) time[BL] = atof(value)/1000;
+        else if (strcmp(token, "winc") == 0) increment[WH] = atof(value)/1000;
+        else if (strcmp(token, "binc") == 0) increment[BL] = atof(value)/1000;
+        else if (strcmp(token, "movestogo") == 0) moves_to_go = atoi(value);
+        else if (strcmp(token, "movetime") == 0) move_time = atof(value)/1000;
+        else if (strcmp(token, "depth") == 0) limits.depth = atoi(value);
+    }
+
+    if (move_time > 0) {
+        limits.time_limit = move_time - MOVE_OVERHEAD;
+    } else if (time[ctx->turn] > 0) {
+        double remaining = time[ctx->turn];
+        limits.time_limit = remaining/(moves_to_go > 0 ? moves_to_go : DEFAULT_MOVES_TO_GO) + increment[ctx->turn]/2;
+        if (limits.time_limit > remaining - MOVE_OVERHEAD) limits.time_limit = remaining - MOVE_OVERHEAD;
+    }
+    // The search treats 0 as no limit, so a clock that already ran out still gets the smallest possible search
+    if ((move_time > 0 || time[ctx->turn] > 0) && limits.time_limit <= 0) limits.time_limit = 0.001;
+    return limits;
+}
+
+int uci_loop(TranspositionTable *tt, int threads, Network *nnue)
+{
+    bool use_nnue = nnue_loaded(nnue);
+    static char line[LINE_CAP];
+    GameContext ctx;
+    EngineJob engine;
+    UciState uci = {.tt = tt};
+    pthread_mutex_init(&uci.lock, NULL);
+
+    load_fen(&ctx, START_FEN);
+    // Without the worker "stop" can't be read during a search, so only searches with a limit end
+    if (!engine_init(&engine)) printf("info string could not start the search thread, searching on the main thread\n");
+    engine.on_done = print_best_move;
+    engine.on_done_data = &uci;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *command = strtok(line, " \t");
+        char *args = strtok(NULL, "");
+        if (command == NULL) continue;
+
+        if (strcmp(command, "uci") == 0) {
+            printf("id name Papyrus Chess\n");
+            printf("id author joaoreboucas1\n");
+            printf("option name Hash type spin default %zu min 1 max 65536\n", tt->bucket_count*sizeof(TTBucket)/(1024*1024));
+            printf("option name Threads type spin default %d min 1 max %d\n", threads, MAX_THREADS);
+            printf("option name EvalFile type string default <empty>\n");
+            printf("option name Use NNUE type check default %s\n", use_nnue ? "true" : "false");
+            printf("uciok\n");
+        } else if (strcmp(command, "isready") == 0) {
+            printf("readyok\n");
+        } else if (strcmp(command, "ucinewgame") == 0) {
+            engine_abort(&engine);
+            tt_clear(tt);
+        } else if (strcmp(command, "setoption") == 0 && args != NULL) {
+            // setoption name <name> value <value>
+            char name[64] = "";
+            char *value = strstr(args, " value ");
+            if (value != NULL) {
+                *value = '\0';
+                value += strlen(" value ");
+            }
+            if (strncmp(args, "name ", 5) == 0) snprintf(name, sizeof(name), "%s", args + 5);
+            if (value == NULL) {
+                printf("info string missing value for %s\n", name);
+            } else if (strcmp(name, "Hash") == 0) {
+                engine_abort(&engine);
+                if (!tt_init(tt, strtoul(value, NULL, 10), tt->huge_pages)) {
+                    printf("info string could not allocate %s MB, falling back to 1 MB\n", value);
+                    tt_init(tt, 1, false);
+                }
+            } else if (strcmp(name, "Threads") == 0) {
+                threads = atoi(value);
+                if (threads < 1) threads = 1;
+                if (threads > MAX_THREADS) threads = MAX_THREADS;
+            } else if (strcmp(name, "EvalFile") == 0) {
+                engine_abort(&engine);
+                // Loaded aside, so that a bad file leaves the current network in place
+                Network loaded;
+                if (nnue_load(&loaded, value)) {
+                    nnue_free(nnue);
+                    *nnue = loaded;
+                    use_nnue = true;
+                    printf("info string loaded the network %s, built for %s\n", value, nnue_simd_name());
+                } else {
+                    printf("info string could not load the network %s\n", value);
+                }
+            } else if (strcmp(name, "Use NNUE") == 0) {
+                use_nnue = strcmp(value, "true") == 0 && nnue_loaded(nnue);
+                if (strcmp(value, "true") == 0 && !use_nnue) printf("info string no network loaded, set EvalFile first\n");
+            } else {
+                printf("info string unknown option %s\n", name);
+            }
+        } else if (strcmp(command, "position") == 0 && args != NULL) {
+            engine_abort(&engine);
+            parse_position(&ctx, args);
+        } else if (strcmp(command, "go") == 0) {
+            // Every "go" gets its answer, even a previous infinite one the GUI never stopped
+            release_best_move(&uci);
+            engine_abort(&engine);
+            SearchLimits limits = parse_go(&ctx, args != NULL ? args : (char[]) {""});
+            uci.hold = limits.infinite;
+            limits.tt = tt;
+            limits.threads = threads;
+            limits.nnue = use_nnue ? nnue : NULL;
+            limits.report = print_info;
+            limits.report_data = &uci;
+            uci.last_depth = 0;
+            engine_start(&engine, &ctx, limits);
+        } else if (strcmp(command, "stop") == 0) {
+            // The worker prints the best move once the search is over, or it is printed here if it already is
+            release_best_move(&uci);
+            engine_cancel(&engine);
+        } else if (strcmp(command, "eval") == 0) {
+            // Not part of UCI, for debugging the evaluation by hand
+            print_evaluation(&ctx, stdout);
+            if (nnue_loaded(nnue)) {
+                Accumulator acc;
+                nnue_refresh_all(nnue, &ctx, &acc);
+                printf("nnue %d for the side to move%s\n", nnue_evaluate(nnue, &acc, ctx.turn), use_nnue ? ", in use" : "");
+            }
+        } else if (strcmp(command, "d") == 0) {
+            // Not part of UCI either, shows the position the moves of `position` led to
+            char fen[FEN_CAP];
+            save_fen(&ctx, fen);
+            printf("Fen: %s\nKey: %016llx\n", fen, (unsigned long long) ctx.key);
+        } else if (strcmp(command, "quit") == 0) {
+            release_best_move(&uci);
+            break;
+        }
+        fflush(stdout);
+    }
+
+    engine_shutdown(&engine);
+    pthread_mutex_destroy(&uci.lock);
+    return 0;
+}
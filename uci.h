@@ -0,0 +1,12 @@
+#ifndef UCI_H_
+#define UCI_H_
+
+#include "nnue.h"
+#include "tt.h"
+
+// Speaks the UCI protocol over stdin/stdout until "quit" or the end of the input, without any window.
+// `tt` must already be allocated; "setoption name Hash" resizes it. `nnue` may hold a network loaded beforehand,
+// "setoption name EvalFile" replaces it. Returns the exit status of the program.
+int uci_loop(TranspositionTable *tt, int threads, Network *nnue);
+
+#endif // UCI_H_